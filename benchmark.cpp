@@ -0,0 +1,33 @@
+#include <iostream>
+#include <iomanip>
+#include <sys/resource.h>
+#include "benchmark.hpp"
+
+Benchmark::Benchmark(bool enabled) {
+    this->enabled = enabled;
+    this->faults = 0;
+    lap(NULL);
+}
+
+void Benchmark::lap(const char *stage) {
+    if (!this->enabled) {
+        return;
+    }
+    struct timespec now;
+    struct rusage usage;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    getrusage(RUSAGE_SELF, &usage);
+    long faults = usage.ru_minflt + usage.ru_majflt;
+
+    // The first lap only starts the clock
+    if (stage != NULL) {
+        double seconds = (now.tv_sec - this->start.tv_sec) + (now.tv_nsec - this->start.tv_nsec) / 1e9;
+        std::cerr << std::left << std::setw(10) << stage << std::right << std::fixed << std::setprecision(3) << std::setw(10) << seconds << " s"
+                  << std::setw(12) << faults - this->faults << " page faults" << std::endl;
+    }
+    this->start = now;
+    this->faults = faults;
+}
+
+Benchmark::~Benchmark() {
+}
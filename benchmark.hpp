@@ -0,0 +1,22 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <time.h>
+
+/**
+ * Times the stages of a run, printing to the standard error how long each one took and how many page faults it
+ * caused, which is where the Placement policies show: huge pages cut the faults (and TLB misses) of the
+ * stages that touch the graph, pinning and interleaving change how the threaded stages scale.
+ */
+class Benchmark {
+    bool enabled;
+    struct timespec start;
+    long faults;
+
+public:
+    Benchmark(bool enabled);          // Creates a benchmark, starting the first stage now. Does nothing if not enabled.
+    void lap(const char *stage);      // Ends the current stage, reporting it under the given name, and starts the next one.
+    virtual ~Benchmark();
+};
+
+#endif //BENCHMARK_H
@@ -0,0 +1,53 @@
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "client.hpp"
+#include "server.hpp"
+
+Client::Client(const std::string &path) {
+    this->path = path;
+}
+
+bool Client::run() {
+    struct sockaddr_un address;
+    if (this->path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << this->path << std::endl;
+        return false;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, this->path.c_str());
+
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection == -1 || connect(connection, (struct sockaddr *) &address, sizeof(address)) == -1) {
+        std::cerr << "Could not connect to " << this->path << ": " << strerror(errno) << std::endl;
+        if (connection != -1) {
+            close(connection);
+        }
+        return false;
+    }
+
+    // Send one query at a time, and print its answer up to the line that ends it
+    std::string query;
+    std::string buffer;
+    bool connected = true;
+    while (connected && std::getline(std::cin, query)) {
+        connected = Server::writeAll(connection, query + "\n");
+        std::string line;
+        while (connected && (connected = Server::readLine(connection, buffer, line)) && line != SERVER_END_OF_ANSWER) {
+            std::cout << line << std::endl;
+        }
+    }
+
+    close(connection);
+    if (!connected) {
+        std::cerr << "Lost connection to " << this->path << std::endl;
+    }
+    return connected;
+}
+
+Client::~Client() {
+}
@@ -0,0 +1,24 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <string>
+
+/**
+ * Sends meeting point queries to a running server and prints its answers.
+ */
+class Client {
+    std::string path;
+
+public:
+    Client(const std::string &path);  // Creates a client for the server listening on path.
+
+    /**
+     * Sends every line of the standard input as a query, printing each answer (without the line ending it).
+     * Returns false if the server couldn't be reached or went away.
+     */
+    bool run();
+
+    virtual ~Client();
+};
+
+#endif //CLIENT_H
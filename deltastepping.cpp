@@ -0,0 +1,217 @@
+#include <algorithm>
+#include "deltastepping.hpp"
+
+#define PHASE_LIGHT 0
+#define PHASE_HEAVY 1
+#define PHASE_STOP 2
+
+template<class C>
+DeltaStepping<C>::DeltaStepping(const Adjacency<C> *forward, const Adjacency<C> *backward, unsigned int placesLength, unsigned int linksLength,
+                               unsigned int threadsLength, bool pinned) {
+    this->forward = forward;
+    this->backward = backward;
+    this->placesLength = placesLength;
+    this->threadsLength = std::max(1u, threadsLength);
+    this->distances = NULL;
+    this->adjacency = forward;
+    this->allowed = NULL;
+    this->phase = PHASE_STOP;
+
+    // Find the most expensive edge
+    this->maximumCost = 0;
+    for (unsigned int edgeIndex = 0; edgeIndex < this->forward->edges.size(); edgeIndex++) {
+        this->maximumCost = std::max(this->maximumCost, this->forward->edges[edgeIndex].cost);
+    }
+
+    // Delta around maximum cost / average degree keeps the expected number of re-relaxations per bucket constant.
+    unsigned int averageDegree = std::max(1u, linksLength / std::max(1u, placesLength - PLACES_START_INDEX));
+    this->delta = std::max((C) 1, this->maximumCost / (C) averageDegree);
+
+    // Tentative distances never go further than maximumCost past the current bucket, so buckets can be reused circularly.
+    this->buckets.resize(this->maximumCost / this->delta + 2);
+    this->frontierStamps.resize(placesLength);
+    this->settledStamps.resize(placesLength);
+
+    // Start the helper threads, the thread calling run works as thread 0.
+    // They wait on starting until the barrier is set up for however many of them actually started.
+    unsigned int requestedLength = this->threadsLength;
+    this->threads.resize(requestedLength);
+    this->arguments.resize(requestedLength);
+    pthread_mutex_init(&this->starting, NULL);
+    pthread_mutex_lock(&this->starting);
+    this->threadsLength = 1;
+    for (unsigned int threadIndex = 1; threadIndex < requestedLength; threadIndex++) {
+        this->arguments[threadIndex].engine = this;
+        this->arguments[threadIndex].index = threadIndex;
+        if (pthread_create(&this->threads[threadIndex], NULL, DeltaStepping<C>::worker, &this->arguments[threadIndex]) != 0) {
+            break;
+        }
+        if (pinned) {
+            Placement::pin(this->threads[threadIndex], threadIndex);
+        }
+        this->threadsLength++;
+    }
+    pthread_barrier_init(&this->barrier, NULL, this->threadsLength);
+    this->requests.resize(this->threadsLength);
+    pthread_mutex_unlock(&this->starting);
+}
+
+template<class C>
+void DeltaStepping<C>::run(unsigned int source, bool reversed, const char *allowed, C *distances) {
+    // Initialize the graph
+    std::fill(distances, distances + this->placesLength, std::numeric_limits<C>::max());
+    this->distances = distances;
+    this->adjacency = reversed ? this->backward : this->forward;
+    this->allowed = allowed;
+    for (unsigned int bucketIndex = 0; bucketIndex < this->buckets.size(); bucketIndex++) {
+        this->buckets[bucketIndex].clear();
+    }
+
+    // Stamps avoid duplicates in the frontier and settled lists. Frontier stamps change every round, settled stamps
+    // every bucket.
+    std::vector<unsigned int, GRAPH_ALLOCATOR<unsigned int> > &frontierStamps = this->frontierStamps;
+    std::vector<C, GRAPH_ALLOCATOR<C> > &settledStamps = this->settledStamps;
+    std::fill(frontierStamps.begin(), frontierStamps.end(), 0);
+    std::fill(settledStamps.begin(), settledStamps.end(), 0);
+    unsigned int round = 0;
+
+    distances[source] = 0;
+    bucket(source);
+    unsigned int pending = 1;
+
+    // Empty the buckets in order
+    for (C bucketIndex = 0; pending > 0; bucketIndex++) {
+        std::vector<unsigned int> &current = this->buckets[bucketIndex % this->buckets.size()];
+        if (current.empty()) {
+            continue;
+        }
+        this->settled.clear();
+
+        // Relax light edges until the bucket stops refilling
+        while (!current.empty()) {
+            std::vector<unsigned int> taken;
+            taken.swap(current);
+            pending -= taken.size();
+
+            // Entries whose distance moved to an earlier bucket are stale, their place was filed again when it improved.
+            round++;
+            this->frontier.clear();
+            for (unsigned int entry = 0; entry < taken.size(); entry++) {
+                unsigned int placeIndex = taken[entry];
+                if (distances[placeIndex] / this->delta == bucketIndex && frontierStamps[placeIndex] != round) {
+                    frontierStamps[placeIndex] = round;
+                    this->frontier.push_back(placeIndex);
+                    if (settledStamps[placeIndex] != bucketIndex + 1) {
+                        settledStamps[placeIndex] = bucketIndex + 1;
+                        this->settled.push_back(placeIndex);
+                    }
+                }
+            }
+
+            broadcast(PHASE_LIGHT);
+            for (unsigned int threadIndex = 0; threadIndex < this->threadsLength; threadIndex++) {
+                std::vector<unsigned int> &improved = this->requests[threadIndex];
+                for (unsigned int entry = 0; entry < improved.size(); entry++) {
+                    bucket(improved[entry]);
+                }
+                pending += improved.size();
+                improved.clear();
+            }
+        }
+
+        // The bucket is settled, so heavy edges only need to be relaxed once
+        broadcast(PHASE_HEAVY);
+        for (unsigned int threadIndex = 0; threadIndex < this->threadsLength; threadIndex++) {
+            std::vector<unsigned int> &improved = this->requests[threadIndex];
+            for (unsigned int entry = 0; entry < improved.size(); entry++) {
+                bucket(improved[entry]);
+            }
+            pending += improved.size();
+            improved.clear();
+        }
+    }
+
+    this->distances = NULL;
+}
+
+template<class C>
+void *DeltaStepping<C>::worker(void *argument) {
+    DeltaSteppingThread<C> *thread = (DeltaSteppingThread<C> *) argument;
+    pthread_mutex_lock(&thread->engine->starting);
+    pthread_mutex_unlock(&thread->engine->starting);
+    thread->engine->work(thread->index);
+    return NULL;
+}
+
+template<class C>
+void DeltaStepping<C>::work(unsigned int threadIndex) {
+    while (true) {
+        pthread_barrier_wait(&this->barrier);
+        if (this->phase == PHASE_STOP) {
+            return;
+        }
+        relax(threadIndex, this->phase == PHASE_LIGHT ? this->frontier : this->settled, this->phase == PHASE_LIGHT);
+        pthread_barrier_wait(&this->barrier);
+    }
+}
+
+template<class C>
+void DeltaStepping<C>::broadcast(int phase) {
+    this->phase = phase;
+    pthread_barrier_wait(&this->barrier);
+    relax(0, phase == PHASE_LIGHT ? this->frontier : this->settled, phase == PHASE_LIGHT);
+    pthread_barrier_wait(&this->barrier);
+}
+
+template<class C>
+void DeltaStepping<C>::relax(unsigned int threadIndex, const std::vector<unsigned int> &origins, bool light) {
+    // Threads take interleaved origins so that high degree places don't all land on the same thread
+    for (unsigned int entry = threadIndex; entry < origins.size(); entry += this->threadsLength) {
+        unsigned int originIndex = origins[entry];
+        C distance = this->distances[originIndex];
+        for (unsigned int edgeIndex = this->adjacency->starts[originIndex]; edgeIndex < this->adjacency->starts[originIndex + 1]; edgeIndex++) {
+            const Edge<C> &edge = this->adjacency->edges[edgeIndex];
+            if ((edge.cost <= this->delta) == light && this->allowed[edge.vertex]) {
+                request(edge.vertex, distance + edge.cost, threadIndex);
+            }
+        }
+    }
+}
+
+template<class C>
+void DeltaStepping<C>::request(unsigned int placeIndex, C distance, unsigned int threadIndex) {
+    // Lower the distance atomically, other threads may be relaxing edges into the same place
+    C current = this->distances[placeIndex];
+    while (distance < current) {
+        if (__sync_bool_compare_and_swap(&this->distances[placeIndex], current, distance)) {
+            this->requests[threadIndex].push_back(placeIndex);
+            return;
+        }
+        current = this->distances[placeIndex];
+    }
+}
+
+template<class C>
+void DeltaStepping<C>::bucket(unsigned int placeIndex) {
+    C bucketIndex = this->distances[placeIndex] / this->delta;
+    this->buckets[bucketIndex % this->buckets.size()].push_back(placeIndex);
+}
+
+template<class C>
+unsigned int DeltaStepping<C>::getThreadsLength() const {
+    return this->threadsLength;
+}
+
+template<class C>
+DeltaStepping<C>::~DeltaStepping() {
+    // Stop the helper threads
+    this->phase = PHASE_STOP;
+    pthread_barrier_wait(&this->barrier);
+    for (unsigned int threadIndex = 1; threadIndex < this->threadsLength; threadIndex++) {
+        pthread_join(this->threads[threadIndex], NULL);
+    }
+    pthread_barrier_destroy(&this->barrier);
+    pthread_mutex_destroy(&this->starting);
+}
+
+template class DeltaStepping<Cost>;
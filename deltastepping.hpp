@@ -0,0 +1,79 @@
+#ifndef DELTASTEPPING_H
+#define DELTASTEPPING_H
+
+#include <vector>
+#include <pthread.h>
+#include "graph.hpp"
+
+template<class C>
+class DeltaStepping;
+
+// What a helper thread gets when started.
+template<class C>
+struct DeltaSteppingThread {
+    DeltaStepping<C> *engine;
+    unsigned int index;
+};
+
+template<class C>
+class DeltaStepping {
+    const Adjacency<C> *forward;
+    const Adjacency<C> *backward;
+    unsigned int placesLength;
+    unsigned int threadsLength;
+    C delta;
+    C maximumCost;
+
+    // State shared with the worker threads during a run.
+    volatile C *distances;
+    const Adjacency<C> *adjacency;
+    const char *allowed;
+    std::vector<std::vector<unsigned int> > buckets;
+    std::vector<std::vector<unsigned int> > requests;
+    std::vector<unsigned int> frontier;
+    std::vector<unsigned int> settled;
+    int phase;
+    pthread_barrier_t barrier;
+
+    // Marks of the first thread for each place, which bucket it was last put in the frontier or settled list for.
+    // Kept between runs like every other per-place array, so that they follow the Placement policies once.
+    std::vector<unsigned int, GRAPH_ALLOCATOR<unsigned int> > frontierStamps;
+    std::vector<C, GRAPH_ALLOCATOR<C> > settledStamps;
+
+    // Helper threads, started once and reused by every run.
+    std::vector<pthread_t> threads;
+    std::vector<DeltaSteppingThread<C> > arguments;
+    pthread_mutex_t starting;              // Held while the helpers are started, so none of them runs before the barrier exists.
+
+public:
+    /**
+     * Prepares a delta-stepping engine over the given edges, which must have non-negative (re-weighted) costs.
+     * Delta is picked from the edge costs and the average degree so that buckets hold a few relaxations each.
+     * The threadsLength - 1 helper threads are started here and kept until the engine is deconstructed, pinned to their
+     * own processors if asked to (and Placement allows it). If some of them can't be started, the engine runs with the
+     * ones that could.
+     */
+    DeltaStepping(const Adjacency<C> *forward, const Adjacency<C> *backward, unsigned int placesLength, unsigned int linksLength,
+                  unsigned int threadsLength, bool pinned);
+
+    /**
+     * Computes the distance from source to every place into distances (indexed by place index), using the calling
+     * thread and the helpers. Runs must not overlap.
+     * When reversed, edges are followed backwards, giving the distances from every place to the source.
+     * Only places marked in allowed are visited, the others are left at infinite.
+     */
+    void run(unsigned int source, bool reversed, const char *allowed, C *distances);
+
+    unsigned int getThreadsLength() const;  // Returns the number of threads runs use, the calling one included.
+    virtual ~DeltaStepping();               // Stops the helper threads and deconstructs the engine.
+
+private:
+    static void *worker(void *argument);  // Entry point of the helper threads.
+    void work(unsigned int threadIndex);  // Runs the phases given by the first thread until told to stop.
+    void relax(unsigned int threadIndex, const std::vector<unsigned int> &origins, bool light);
+    void request(unsigned int placeIndex, C distance, unsigned int threadIndex);
+    void bucket(unsigned int placeIndex);  // Files a place in the bucket of its current distance.
+    void broadcast(int phase);             // Runs a phase on every thread and waits for all of them.
+};
+
+#endif //DELTASTEPPING_H
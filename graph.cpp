@@ -1,345 +1,724 @@
 #include <iostream>
+#include <algorithm>
+#include <utility>
+#include <queue>
+#include <unistd.h>
 #include "graph.hpp"
+#ifndef BOTNET_SEQUENTIAL
+#include "deltastepping.hpp"
+#endif
 
 //
-// Edge (Template)
+// Vertex (Template)
 //
 
-template<class T>
-Edge<T>::Edge(Vertex<T> *const vertex, int cost) {
-    this->vertex = vertex;
-    this->cost = cost;
-}
-
-template<class T>
-Edge<T>::~Edge() {
-
+template<class C, class P>
+Vertex<C, P>::Vertex(unsigned int id) : P(id) {
+    this->h = 0;
 }
 
 //
-// Vertex (Template)
+// Query (Class)
 //
 
-template<class T>
-Vertex<T>::Vertex(T element) {
-    this->element = element;
-    this->reset();
-}
-
-template<class T>
-void Vertex<T>::addLink(Vertex<T> *const vertex, int cost) {
-    this->edges.push_back(new Edge<T>(vertex, cost));
-}
-
-template<class T>
-inline void Vertex<T>::reset() {
-    this->distance = INFINITE;
-    this->parent = NULL;
-}
-
-template<class T>
-void Vertex<T>::saveDistance() {
-    this->h = this->distance;
-}
-
-template<class T>
-inline std::list<Edge<T> *> &Vertex<T>::getEdges() {
-    return this->edges;
-}
-
-template<class T>
-bool Vertex<T>::operator < (const Vertex<T>* const &v) const {
-    // This is INTENTIONALLY inverted, so that higher distances are "worse"
-    return distance > v->distance;
-};
-
-template<class T>
-Vertex<T>::~Vertex() {
-    delete this->element;
-    for (typename std::list<Edge<T> *>::iterator it = this->edges.begin(); it != this->edges.end(); it++) {
-        Edge<T> *edge = *it;
-        delete edge;
-    }
+Query::Query() {
+    this->objective = OBJECTIVE_SUM;
+    this->engine = ENGINE_AUTO;
+    this->branchesOnly = false;
+    this->k = 1;
 }
 
 //
-// Graph (Class)
+// Graph (Template)
 //
 
-Graph::Graph() {
+template<class C, class P, template<class> class Q>
+Graph<C, P, Q>::Graph() {
     this->placesLength = 0;
-    this->branchesLength = 0;
+    this->linksLength = 0;
+    this->engine = ENGINE_AUTO;
+    this->format = FORMAT_TEXT;
+    this->reweighted = false;
+    this->maximumCost = 0;
+    this->bucketWidth = 1;
+#ifndef BOTNET_SEQUENTIAL
+    pthread_mutex_init(&this->idleEnginesLock, NULL);
+#endif
 }
 
-void Graph::populate() {
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::populate(std::istream &input) {
+    clear();
+
     // Parse first line
-    unsigned int linksLength;
-    std::cin >> this->placesLength >> this->branchesLength >> linksLength;
+    unsigned int branchesLength;
+    input >> this->placesLength >> branchesLength >> this->linksLength;
     // places starts at 1 and 0 is saved for the s vertex in johnson's algorithm, so add 1 extra place for s.
     this->placesLength++;
-    this->places = new Vertex<Place *> *[placesLength];
-    this->places[S_INDEX] = NULL;
-    this->branches = new Vertex<Place *> *[branchesLength];
-    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Place *place = new Place(placeIndex);
-        this->places[placeIndex] = new Vertex<Place *>(place);
+    this->places.reserve(this->placesLength);
+    for (unsigned int placeIndex = 0; placeIndex < this->placesLength; placeIndex++) {
+        this->places.push_back(Vertex<C, P>(placeIndex));
     }
 
     // Parse second line
-    for (unsigned int branchIndex = 0; branchIndex < this->branchesLength; branchIndex++) {
-        unsigned int id;
-        std::cin >> id;
-        Vertex<Place *> *vertex = this->places[id];
-        Place *place = vertex->element;
-        place->branch = new Branch();
-        this->branches[branchIndex] = vertex;
+    this->branches.resize(branchesLength);
+    for (unsigned int branchIndex = 0; branchIndex < branchesLength; branchIndex++) {
+        input >> this->branches[branchIndex];
+        this->places[this->branches[branchIndex]].setBranch();
     }
 
     // Parse connections
-    for (unsigned int connection = 0; connection < linksLength; connection++) {
-        unsigned int from, to;
-        int cost;
-        std::cin >> from >> to >> cost;
+    std::vector<unsigned int> origins(this->linksLength);
+    std::vector<Edge<C> > links(this->linksLength);
+    for (unsigned int connection = 0; connection < this->linksLength; connection++) {
+        input >> origins[connection] >> links[connection].vertex >> links[connection].cost;
+    }
 
-        // IDs start at 1, but we store them from 0
-        this->places[from]->addLink(this->places[to], cost);
+    // Pack the edges by origin, and by destination for the backward ones.
+    // Count the edges of each vertex first, so each of them knows where its edges start.
+    this->forward.starts.assign(this->placesLength + 1, 0);
+    this->backward.starts.assign(this->placesLength + 1, 0);
+    for (unsigned int connection = 0; connection < this->linksLength; connection++) {
+        this->forward.starts[origins[connection] + 1]++;
+        this->backward.starts[links[connection].vertex + 1]++;
+    }
+    for (unsigned int placeIndex = 0; placeIndex < this->placesLength; placeIndex++) {
+        this->forward.starts[placeIndex + 1] += this->forward.starts[placeIndex];
+        this->backward.starts[placeIndex + 1] += this->backward.starts[placeIndex];
+    }
+    this->forward.edges.resize(this->linksLength);
+    this->backward.edges.resize(this->linksLength);
+    std::vector<unsigned int> forwardEnds(this->forward.starts.begin(), this->forward.starts.end() - 1);
+    std::vector<unsigned int> backwardEnds(this->backward.starts.begin(), this->backward.starts.end() - 1);
+    for (unsigned int connection = 0; connection < this->linksLength; connection++) {
+        unsigned int from = origins[connection];
+        unsigned int to = links[connection].vertex;
+        this->forward.edges[forwardEnds[from]++] = links[connection];
+        Edge<C> &backwardEdge = this->backward.edges[backwardEnds[to]++];
+        backwardEdge.vertex = from;
+        backwardEdge.cost = links[connection].cost;
     }
 }
 
-void Graph::execute() {
-    johnson();
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::setEngine(Engine engine) {
+    this->engine = engine;
+}
+
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::setFormat(Format format) {
+    this->format = format;
+}
+
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::execute(const Query &query) {
+    johnson(query);
+}
+
+template<class C, class P, template<class> class Q>
+std::vector<unsigned int> Graph<C, P, Q>::getBranches() const {
+    return this->branches;
+}
+
+template<class C, class P, template<class> class Q>
+unsigned int Graph<C, P, Q>::getPlacesLength() const {
+    return this->placesLength - PLACES_START_INDEX;
 }
 
-void Graph::print() const {
-    std::cout << "Places: " << this->placesLength - 1 << ", Branches: " << this->branchesLength << std::endl;
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::print() const {
+    std::cout << "Places: " << this->placesLength - 1 << ", Branches: " << this->branches.size() << std::endl;
     for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *vertex = this->places[placeIndex];
-        std::cout << "Place " << vertex->element->id << "[" << vertex << "]" << " has branch? " << (vertex->element->branch != NULL) << " is linked to: " << std::endl;
-        std::list<Edge<Place *> *> &links = vertex->getEdges();
-        for (std::list<Edge<Place *> *>::iterator it = links.begin(); it != links.end(); it++) {
-            Edge<Place *> *edge = *it;
-            Vertex<Place *> *linked = edge->vertex;
-            std::cout << "\t-> Place " << linked->element->id << "[" << linked << "] with cost " << edge->cost << " and has branch? " << (linked->element->branch != NULL) << std::endl;
+        std::cout << "Place " << placeIndex;
+        this->places[placeIndex].describe(std::cout);
+        std::cout << " is linked to: " << std::endl;
+        for (unsigned int edgeIndex = this->forward.starts[placeIndex]; edgeIndex < this->forward.starts[placeIndex + 1]; edgeIndex++) {
+            const Edge<C> &edge = this->forward.edges[edgeIndex];
+            std::cout << "\t-> Place " << edge.vertex << " with cost " << edge.cost;
+            this->places[edge.vertex].describe(std::cout);
+            std::cout << std::endl;
         }
     }
 }
 
-bool Graph::bellmanFord(Vertex<Place *> *source) {
-    // Initialize the graph
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::bellmanFord() {
+    // s reaches every place with cost 0 in one step, so start from there
     for (unsigned int placeIndex = 0; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *vertex = places[placeIndex];
-        if (vertex != NULL)
-            vertex->reset();
+        this->places[placeIndex].h = 0;
     }
-    source->distance = 0;
 
     // Relax edges
     for (unsigned int iteration = 0; iteration < this->placesLength; iteration++) {
+        // Use this flag to check whether anything changed on the iteration
+        // If nothing changed, no need to continue as nothing will change in the next step
+        bool done = true;
+
         // For each edge, relax if possible
-        for (unsigned int placeIndex = 0; placeIndex < this->placesLength; placeIndex++) {
-            Vertex<Place *> *origin = places[placeIndex];
-            if (origin != NULL) {
-                std::list<Edge<Place *> *> &edges = origin->getEdges();
-                for (std::list<Edge<Place *> *>::iterator it = edges.begin(); it != edges.end(); it++) {
-                    Edge<Place *> *edge = *it;
-                    Vertex<Place *> *destination = edge->vertex;
-                    // If can relax, do it! Check if origin is infinite so stuff doest overflow!
-                    // Also sum overflow happens we do nothing to prevent it. SO DON'T MAKE EDGES HEIGHT HIGH!
-                    if (origin->distance != INFINITE && origin->distance + edge->cost < destination->distance) {
-                        destination->distance = origin->distance + edge->cost;
-                        destination->parent = origin;
-                    }
+        for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
+            C origin = this->places[placeIndex].h;
+            for (unsigned int edgeIndex = this->forward.starts[placeIndex]; edgeIndex < this->forward.starts[placeIndex + 1]; edgeIndex++) {
+                const Edge<C> &edge = this->forward.edges[edgeIndex];
+                // Overflow is possible for enormous (near the maximum of C) weights
+                if (origin + edge.cost < this->places[edge.vertex].h) {
+                    this->places[edge.vertex].h = origin + edge.cost;
+                    done = false;
                 }
             }
         }
+
+        if (done) {
+            break;
+        }
     }
+}
 
-    // Check for negative cycles
-    // Commented because there will be no negative loops, so no need for checks.
-    /*for (unsigned int i = 0; i < this->placesLength; i++) {
-        // For each edge, relax if possible
-        for (unsigned int place = 0; place < this->placesLength; place++) {
-            Vertex<Place *> *origin = places[place];
-            std::list<Edge<Place *> *> &edges = origin->getEdges();
-            for (std::list<Edge<Place *> *>::iterator it = edges.begin(); it != edges.end(); it++) {
-                Edge<Place *> *edge = *it;
-                Vertex<Place *> *destination = edge->vertex;
-                // If we can relax, its because there is a negative cycle
-                if (origin->distance + edge->cost < destination->distance) {
-                    return false;
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::condense() {
+    const unsigned int unvisited = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> &components = this->condensation.components;
+    components.assign(this->placesLength, 0);
+    this->condensation.componentsLength = 0;
+
+    // Tarjan's algorithm, with an explicit stack of (place, next edge) frames instead of recursion,
+    // as a long path would overflow the call stack.
+    std::vector<unsigned int> indexes(this->placesLength, unvisited);
+    std::vector<unsigned int> lowLinks(this->placesLength);
+    std::vector<char> stacked(this->placesLength, false);
+    std::vector<unsigned int> stack;
+    std::vector<std::pair<unsigned int, unsigned int> > frames;
+    unsigned int counter = 0;
+    for (unsigned int rootIndex = PLACES_START_INDEX; rootIndex < this->placesLength; rootIndex++) {
+        if (indexes[rootIndex] != unvisited) {
+            continue;
+        }
+        indexes[rootIndex] = lowLinks[rootIndex] = counter++;
+        stack.push_back(rootIndex);
+        stacked[rootIndex] = true;
+        frames.push_back(std::make_pair(rootIndex, this->forward.starts[rootIndex]));
+
+        while (!frames.empty()) {
+            unsigned int placeIndex = frames.back().first;
+            unsigned int edgeIndex = frames.back().second;
+            if (edgeIndex < this->forward.starts[placeIndex + 1]) {
+                // Follow the next edge, descending into the place at its end if it's new
+                frames.back().second++;
+                unsigned int nextIndex = this->forward.edges[edgeIndex].vertex;
+                if (indexes[nextIndex] == unvisited) {
+                    indexes[nextIndex] = lowLinks[nextIndex] = counter++;
+                    stack.push_back(nextIndex);
+                    stacked[nextIndex] = true;
+                    frames.push_back(std::make_pair(nextIndex, this->forward.starts[nextIndex]));
+                } else if (stacked[nextIndex]) {
+                    lowLinks[placeIndex] = std::min(lowLinks[placeIndex], indexes[nextIndex]);
                 }
+                continue;
+            }
+
+            // Every edge is done, so the place is the root of a component if nothing below it reached further up
+            if (lowLinks[placeIndex] == indexes[placeIndex]) {
+                unsigned int memberIndex;
+                do {
+                    memberIndex = stack.back();
+                    stack.pop_back();
+                    stacked[memberIndex] = false;
+                    components[memberIndex] = this->condensation.componentsLength;
+                } while (memberIndex != placeIndex);
+                this->condensation.componentsLength++;
+            }
+            frames.pop_back();
+            if (!frames.empty()) {
+                unsigned int parentIndex = frames.back().first;
+                lowLinks[parentIndex] = std::min(lowLinks[parentIndex], lowLinks[placeIndex]);
             }
         }
-    }*/
-    return true;
-}
+    }
 
-void Graph::dijkstra(Vertex<Place *> *source) {
-    // Initialize the graph
+    // Pack the edges between components like the place edges, counting them first
+    std::vector<unsigned int> &starts = this->condensation.starts;
+    starts.assign(this->condensation.componentsLength + 1, 0);
     for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *vertex = places[placeIndex];
-        vertex->reset();
+        for (unsigned int edgeIndex = this->forward.starts[placeIndex]; edgeIndex < this->forward.starts[placeIndex + 1]; edgeIndex++) {
+            if (components[placeIndex] != components[this->forward.edges[edgeIndex].vertex]) {
+                starts[components[placeIndex] + 1]++;
+            }
+        }
     }
+    for (unsigned int component = 0; component < this->condensation.componentsLength; component++) {
+        starts[component + 1] += starts[component];
+    }
+    this->condensation.successors.resize(starts[this->condensation.componentsLength]);
+    std::vector<unsigned int> ends(starts.begin(), starts.end() - 1);
+    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
+        for (unsigned int edgeIndex = this->forward.starts[placeIndex]; edgeIndex < this->forward.starts[placeIndex + 1]; edgeIndex++) {
+            unsigned int successor = components[this->forward.edges[edgeIndex].vertex];
+            if (components[placeIndex] != successor) {
+                this->condensation.successors[ends[components[placeIndex]]++] = successor;
+            }
+        }
+    }
+}
 
-    // Create the priority queue (reversed)
-    std::priority_queue<Vertex<Place*> *> queue;
+template<class C, class P, template<class> class Q>
+bool Graph<C, P, Q>::prune(const std::vector<unsigned int> &sources, const std::vector<unsigned int> &candidates, bool everyPlace, std::vector<char, GRAPH_ALLOCATOR<char> > &allowed) const {
+    const Condensation &condensation = this->condensation;
+    unsigned int componentsLength = condensation.componentsLength;
 
-    // Insert the source into the queue, with distance 0
-    source->distance = 0;
-    queue.push(source);
+    // Branches in the same component reach the same places, so only their components matter
+    std::vector<unsigned int> sourceComponents(sources.size());
+    for (unsigned int sourceIndex = 0; sourceIndex < sources.size(); sourceIndex++) {
+        sourceComponents[sourceIndex] = condensation.components[sources[sourceIndex]];
+    }
+    std::sort(sourceComponents.begin(), sourceComponents.end());
+    sourceComponents.erase(std::unique(sourceComponents.begin(), sourceComponents.end()), sourceComponents.end());
+
+    // A component is reachable by everyone if each group of 64 sources reaches it with all of its bits.
+    // Going down the component numbers is a topological order, so each component has all of its bits before passing them on.
+    std::vector<char> reachable(componentsLength, true);
+    std::vector<uint64_t> reached(componentsLength);
+    for (unsigned int groupStart = 0; groupStart < sourceComponents.size(); groupStart += 64) {
+        unsigned int groupLength = std::min(64u, (unsigned int) sourceComponents.size() - groupStart);
+        uint64_t everyone = groupLength == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << groupLength) - 1;
+        std::fill(reached.begin(), reached.end(), 0);
+        for (unsigned int bit = 0; bit < groupLength; bit++) {
+            reached[sourceComponents[groupStart + bit]] |= (uint64_t) 1 << bit;
+        }
+        for (unsigned int component = componentsLength; component-- > 0;) {
+            if (reached[component] == 0) {
+                continue;
+            }
+            for (unsigned int successorIndex = condensation.starts[component]; successorIndex < condensation.starts[component + 1]; successorIndex++) {
+                reached[condensation.successors[successorIndex]] |= reached[component];
+            }
+        }
+        for (unsigned int component = 0; component < componentsLength; component++) {
+            reachable[component] = reachable[component] && reached[component] == everyone;
+        }
+    }
 
-    // Run dijkstra main loop
-    while (!queue.empty()){
-        // Get top element from the priority queue and remove it afterwards
-        Vertex<Place *> *current = queue.top();
-        queue.pop();
+    // Mark the components holding a valid meeting point
+    std::vector<char> relevant(componentsLength, false);
+    bool found = false;
+    unsigned int candidatesLength = everyPlace ? this->placesLength - PLACES_START_INDEX : candidates.size();
+    for (unsigned int candidateIndex = 0; candidateIndex < candidatesLength; candidateIndex++) {
+        unsigned int component = condensation.components[everyPlace ? PLACES_START_INDEX + candidateIndex : candidates[candidateIndex]];
+        if (reachable[component]) {
+            relevant[component] = true;
+            found = true;
+        }
+    }
+    if (!found) {
+        return false;
+    }
 
-        // Iterate through every neighbour
-        std::list<Edge<Place *> *> &edges = current->getEdges();
-        for (std::list<Edge<Place *> *>::iterator it = edges.begin(); it != edges.end(); it++) {
-            Edge<Place *> *edge = *it;
-            Vertex<Place *> *destination = edge->vertex;
-
-            // If this newly discovered distance is shorter than the previous ones
-            if (current->distance + edge->cost < destination->distance) {
-                destination->distance = current->distance + edge->cost;
-                // Parent isn't needed for anything
-                // destination->parent = current;
-                queue.push(destination);
-            }
+    // Then every component leading to one of them, going up the component numbers so successors are done first
+    for (unsigned int component = 0; component < componentsLength; component++) {
+        for (unsigned int successorIndex = condensation.starts[component]; successorIndex < condensation.starts[component + 1] && !relevant[component]; successorIndex++) {
+            relevant[component] = relevant[condensation.successors[successorIndex]];
         }
     }
-}
 
-void Graph::transpose() {
-    // Store the number of edges for each vertex
-    // Store it under its distance since it was ruined anyway
+    allowed.assign(this->placesLength, false);
     for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *vertex = places[placeIndex];
-        std::list<Edge<Place *> *> &edges = vertex->getEdges();
-        vertex->distance = edges.size();
+        allowed[placeIndex] = relevant[condensation.components[placeIndex]];
     }
+    return true;
+}
 
-    // Iterate each vertex
-    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *origin = places[placeIndex];
-        std::list<Edge<Place *> *> &edges = origin->getEdges();
-
-        // Since we know how many edges it has, we can avoid running this twice for the same edge
-        while (origin->distance != 0) {
-            // Get the edge and create its tranposition
-            Edge<Place *> *edge = edges.front();
-            Vertex<Place *> *destination = edge->vertex;
-            destination->addLink(origin, edge->cost);
-
-            // Destroy the edge and decrease the counter
-            edges.pop_front();
-            delete edge;
-            origin->distance--;
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::batchedDijkstra(const unsigned int *sources, unsigned int sourcesLength, bool reversed, const char *allowed, C *distances) const {
+    const C infinite = std::numeric_limits<C>::max();
+    const Adjacency<C> &adjacency = reversed ? this->backward : this->forward;
+
+    // Initialize every lane of every place, including the lanes no source will use
+    std::fill(distances, distances + this->placesLength * BATCH_WIDTH, infinite);
+
+    // Lanes of each place that changed since it was last expanded, one bit per lane
+    std::vector<LaneMask, GRAPH_ALLOCATOR<LaneMask> > pending(this->placesLength, 0);
+
+    // Smallest distance among the pending lanes of each place, which decides the bucket it's in.
+    // Bucket entries whose key has moved to another bucket are stale and get skipped.
+    std::vector<C, GRAPH_ALLOCATOR<C> > keys(this->placesLength, infinite);
+
+    // Expanding a place relaxes its pending lanes up to reach buckets past the current one, the rest wait for later.
+    // Pending distances then never go past twice that, so buckets can be reused circularly.
+    // The queue holds the number of each bucket that went from empty to holding places, smallest on top.
+    const C bucketWidth = this->bucketWidth;
+    const C reach = this->maximumCost / bucketWidth;
+    std::vector<std::vector<unsigned int> > buckets(reach * 2 + 2);
+    Q<C> queue;
+
+    // Insert every source, each with distance 0 in its own lane
+    for (unsigned int lane = 0; lane < sourcesLength; lane++) {
+        unsigned int sourceIndex = sources[lane];
+        distances[sourceIndex * BATCH_WIDTH + lane] = 0;
+        pending[sourceIndex] |= (LaneMask) 1 << lane;
+        if (keys[sourceIndex] != 0) {
+            keys[sourceIndex] = 0;
+            buckets[0].push_back(sourceIndex);
+        }
+    }
+    if (sourcesLength > 0) {
+        queue.push(0);
+    }
+
+    // Run the label-correcting main loop, a bucket at a time. Expanding a place relaxes all of its pending lanes at once,
+    // so a single walk through its edges serves every source. Places expanded in the same bucket can be expanded
+    // again when one of their lanes improves, so every lane still ends with its exact distance.
+    while (!queue.empty()) {
+        C bucketIndex = queue.top();
+        queue.pop();
+        std::vector<unsigned int> &bucket = buckets[bucketIndex % buckets.size()];
+
+        // Expanding places can put more places in the same bucket, so keep going until it stays empty
+        while (!bucket.empty()) {
+            std::vector<unsigned int> taken;
+            taken.swap(bucket);
+            for (unsigned int entry = 0; entry < taken.size(); entry++) {
+                unsigned int currentIndex = taken[entry];
+                if (keys[currentIndex] == infinite || keys[currentIndex] / bucketWidth != bucketIndex) {
+                    continue;
+                }
+                const C *current = distances + currentIndex * BATCH_WIDTH;
+
+                // Split the pending lanes into the ones expanded now and the ones left for a later bucket
+                LaneMask expanded = 0;
+                C rest = infinite;
+                for (unsigned int lane = 0; lane < BATCH_WIDTH; lane++) {
+                    if (pending[currentIndex] & ((LaneMask) 1 << lane)) {
+                        if (current[lane] / bucketWidth <= bucketIndex + reach) {
+                            expanded |= (LaneMask) 1 << lane;
+                        } else {
+                            rest = std::min(rest, current[lane]);
+                        }
+                    }
+                }
+                pending[currentIndex] &= ~expanded;
+                keys[currentIndex] = rest;
+                if (rest != infinite) {
+                    std::vector<unsigned int> &restBucket = buckets[(rest / bucketWidth) % buckets.size()];
+                    if (restBucket.empty()) {
+                        queue.push(rest / bucketWidth);
+                    }
+                    restBucket.push_back(currentIndex);
+                }
+
+                // Iterate through every neighbour
+                for (unsigned int edgeIndex = adjacency.starts[currentIndex]; edgeIndex < adjacency.starts[currentIndex + 1]; edgeIndex++) {
+                    const Edge<C> &edge = adjacency.edges[edgeIndex];
+                    if (!allowed[edge.vertex]) {
+                        continue;
+                    }
+                    C *destination = distances + edge.vertex * BATCH_WIDTH;
+
+                    // Relax the expanded lanes, remembering the smallest distance that improved
+                    C improved = infinite;
+                    LaneMask changed = 0;
+                    for (unsigned int lane = 0; lane < BATCH_WIDTH; lane++) {
+                        if ((expanded & ((LaneMask) 1 << lane)) && current[lane] + edge.cost < destination[lane]) {
+                            destination[lane] = current[lane] + edge.cost;
+                            changed |= (LaneMask) 1 << lane;
+                            improved = std::min(improved, destination[lane]);
+                        }
+                    }
+                    pending[edge.vertex] |= changed;
+
+                    // Move the place to an earlier bucket if it needs one, a lower key in the same bucket needs nothing
+                    if (improved < keys[edge.vertex]) {
+                        bool moved = keys[edge.vertex] == infinite || keys[edge.vertex] / bucketWidth != improved / bucketWidth;
+                        keys[edge.vertex] = improved;
+                        if (moved) {
+                            std::vector<unsigned int> &destinationBucket = buckets[(improved / bucketWidth) % buckets.size()];
+                            if (destinationBucket.empty() && improved / bucketWidth != bucketIndex) {
+                                queue.push(improved / bucketWidth);
+                            }
+                            destinationBucket.push_back(edge.vertex);
+                        }
+                    }
+                }
+            }
         }
     }
 }
 
-std::list<Vertex<Place *> *> Graph::path(Vertex<Place *> *destination) {
-    std::list<Vertex<Place *> *> path;
-    Vertex<Place *> *current = destination;
-    while (current->parent != NULL) {
-        path.push_front(current);
-        current = current->parent;
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::search(const unsigned int *sources, unsigned int sourcesLength, bool reversed, const char *allowed, DeltaStepping<C> *deltaStepping, C *distances) const {
+#ifndef BOTNET_SEQUENTIAL
+    if (deltaStepping != NULL) {
+        deltaStepping->run(sources[0], reversed, allowed, distances);
+        return;
     }
-    path.push_front(current);
-    return path;
+#endif
+    batchedDijkstra(sources, sourcesLength, reversed, allowed, distances);
 }
 
-void Graph::johnson() {
-    // Create s vertex.
-    this->places[S_INDEX] = new Vertex<Place *>(NULL);
-    // Add a edge from s to every vertex with cost 0.
-    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        this->places[S_INDEX]->addLink(places[placeIndex], 0);
+template<class C, class P, template<class> class Q>
+Engine Graph<C, P, Q>::chooseEngine(unsigned int sourcesLength, unsigned int threadsLength) const {
+#ifdef BOTNET_SEQUENTIAL
+    return ENGINE_DIJKSTRA;
+#else
+    if (threadsLength < 2 || this->placesLength < DELTA_STEPPING_MIN_PLACES || this->linksLength < this->placesLength) {
+        return ENGINE_DIJKSTRA;
     }
-    // Run bellmanFord in s.
-    bellmanFord(this->places[S_INDEX]);
+    unsigned int batchedPasses = (sourcesLength + BATCH_WIDTH - 1) / BATCH_WIDTH;
+    return sourcesLength * 2 < batchedPasses * threadsLength ? ENGINE_DELTA_STEPPING : ENGINE_DIJKSTRA;
+#endif
+}
 
-    // Save the distances calculated in vertex's h field
-    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *vertex = places[placeIndex];
-        vertex->saveDistance();
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::prepare() {
+    // Runs bellman-ford from s and re-weights every edge so that none is negative.
+    // Only does so the first time it's called.
+    if (this->reweighted) {
+        return;
     }
+    this->reweighted = true;
+
+    // Save the distances from s in each vertex's h field.
+    bellmanFord();
+
+    // Find the components, so queries can tell early which places are worth searching.
+    condense();
 
-    // Re-weight the edges.
+    // Re-weight the edges, and their backward copies.
     for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *origin = places[placeIndex];
-        std::list<Edge<Place *> *> &edges = origin->getEdges();
-        for (std::list<Edge<Place *> *>::iterator it = edges.begin(); it != edges.end(); it++) {
-            Edge<Place *> *edge = *it;
-            Vertex<Place *> *destination = edge->vertex;
-            edge->cost = edge->cost + origin->h - destination->h;
+        C h = this->places[placeIndex].h;
+        for (unsigned int edgeIndex = this->forward.starts[placeIndex]; edgeIndex < this->forward.starts[placeIndex + 1]; edgeIndex++) {
+            Edge<C> &edge = this->forward.edges[edgeIndex];
+            edge.cost = edge.cost + h - this->places[edge.vertex].h;
         }
+        for (unsigned int edgeIndex = this->backward.starts[placeIndex]; edgeIndex < this->backward.starts[placeIndex + 1]; edgeIndex++) {
+            Edge<C> &edge = this->backward.edges[edgeIndex];
+            edge.cost = edge.cost + this->places[edge.vertex].h - h;
+        }
+    }
+
+    // Buckets of the batched dijkstra span the most expensive edge over the average degree, like delta-stepping's,
+    // divided again by the number of lanes, as a batch expands that many times more places per bucket.
+    this->maximumCost = 0;
+    for (unsigned int edgeIndex = 0; edgeIndex < this->forward.edges.size(); edgeIndex++) {
+        this->maximumCost = std::max(this->maximumCost, this->forward.edges[edgeIndex].cost);
     }
+    unsigned int averageDegree = std::max(1u, this->linksLength / std::max(1u, this->placesLength - PLACES_START_INDEX));
+    this->bucketWidth = std::max((C) 1, this->maximumCost / (C) averageDegree / (C) BATCH_WIDTH);
+}
 
-    // Delete s to run Dijkstra.
-    delete this->places[S_INDEX];
-    this->places[S_INDEX] = NULL;
+template<class C, class P, template<class> class Q>
+std::vector<Selection<C> > Graph<C, P, Q>::select(const Query &query, unsigned int threadsLength) const {
+    const C infinite = std::numeric_limits<C>::max();
 
-    // Array that will contain the total losses per place
-    int totalLoss[placesLength];
-    std::fill(totalLoss, totalLoss + placesLength, 0);
+    // Find the branches meeting
+    const std::vector<unsigned int> &sources = query.branches.empty() ? this->branches : query.branches;
+    unsigned int sourcesLength = sources.size();
+
+    // Find the places allowed as meeting points
+    const std::vector<unsigned int> &candidates = query.branchesOnly ? sources : query.candidates;
+    bool everyPlace = candidates.empty() && !query.branchesOnly;
+
+    // Narrow the searches down to the places that lead to a valid meeting point, and stop right away if there are none
+    std::vector<char, GRAPH_ALLOCATOR<char> > allowed;
+    if (query.k == 0 || !prune(sources, candidates, everyPlace, allowed)) {
+        return std::vector<Selection<C> >();
+    }
+
+    // Branches are processed BATCH_WIDTH at a time, so each pass through the edges is shared by the whole batch.
+    // With few branches on a big graph, each branch gets all cores through delta-stepping instead.
+    // The query's engine comes first, then the graph's, and the choice is only made here if neither picked one.
+    Engine engine = query.engine != ENGINE_AUTO ? query.engine : this->engine;
+    if (engine == ENGINE_AUTO) {
+        engine = chooseEngine(sourcesLength, threadsLength > 0 ? threadsLength : sysconf(_SC_NPROCESSORS_ONLN));
+    }
+    DeltaStepping<C> *deltaStepping = NULL;
+    unsigned int batchWidth = BATCH_WIDTH;
+#ifndef BOTNET_SEQUENTIAL
+    if (engine == ENGINE_DELTA_STEPPING) {
+        deltaStepping = acquireEngine(threadsLength);
+        batchWidth = 1;
+    }
+#endif
+    std::vector<C, GRAPH_ALLOCATOR<C> > distances(this->placesLength * BATCH_WIDTH);
+
+    // Array that will contain the total losses per place.
+    // Minimax starts as low as possible, so that the first branch's loss always replaces it.
+    C initialLoss = query.objective == OBJECTIVE_MINIMAX && sourcesLength > 0 ? std::numeric_limits<C>::min() : 0;
+    std::vector<C, GRAPH_ALLOCATOR<C> > totalLoss(this->placesLength, initialLoss);
 
     // Run Dijkstra and calculate total loss to every place, from each branch.
-    for (unsigned int branchIndex = 0; branchIndex < branchesLength; branchIndex++) {
-        Vertex<Place *> *source = branches[branchIndex];
-        dijkstra(source);
-        for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < placesLength; placeIndex++) {
-            Vertex<Place *> *destination = places[placeIndex];
-
-            // If distance is infinite then distance will remain infinite since we can't reach the destination from source.
-            // Only reason we do this rather than just sum infinite with infinite is to prevent integer overflows.
-            if (destination->distance == INFINITE) {
-                totalLoss[placeIndex] = INFINITE;
-            } else if (totalLoss[placeIndex] != INFINITE) {
-                totalLoss[placeIndex] += destination->distance + destination->h - source->h;
+    for (unsigned int batchStart = 0; batchStart < sourcesLength; batchStart += batchWidth) {
+        unsigned int batchLength = std::min(batchWidth, sourcesLength - batchStart);
+        search(&sources[batchStart], batchLength, false, &allowed[0], deltaStepping, &distances[0]);
+        for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
+            const C *destinationDistances = &distances[placeIndex * batchWidth];
+
+            for (unsigned int lane = 0; lane < batchLength; lane++) {
+                // If distance is infinite then distance will remain infinite since we can't reach the destination from source.
+                // Only reason we do this rather than just sum infinite with infinite is to prevent integer overflows.
+                if (destinationDistances[lane] == infinite) {
+                    totalLoss[placeIndex] = infinite;
+                } else if (totalLoss[placeIndex] != infinite) {
+                    unsigned int branchIndex = batchStart + lane;
+                    C loss = destinationDistances[lane] + this->places[placeIndex].h - this->places[sources[branchIndex]].h;
+                    if (query.objective == OBJECTIVE_MINIMAX) {
+                        totalLoss[placeIndex] = std::max(totalLoss[placeIndex], loss);
+                    } else if (query.objective == OBJECTIVE_WEIGHTED_SUM && branchIndex < query.weights.size()) {
+                        totalLoss[placeIndex] += query.weights[branchIndex] * loss;
+                    } else {
+                        totalLoss[placeIndex] += loss;
+                    }
+                }
+            }
+        }
+    }
+
+    // Keep the k best places in a heap, with the worst of them on top.
+    // Ties go to the lowest place id, like a plain scan for the minimum would.
+    typedef std::pair<C, unsigned int> Candidate;
+    std::priority_queue<Candidate> best;
+    std::vector<bool> seen(this->placesLength, false);
+    unsigned int candidatesLength = everyPlace ? this->placesLength - PLACES_START_INDEX : candidates.size();
+    for (unsigned int candidateIndex = 0; candidateIndex < candidatesLength; candidateIndex++) {
+        unsigned int placeIndex = everyPlace ? PLACES_START_INDEX + candidateIndex : candidates[candidateIndex];
+        if (totalLoss[placeIndex] == infinite || seen[placeIndex]) {
+            continue;
+        }
+        seen[placeIndex] = true;
+
+        Candidate candidate(totalLoss[placeIndex], placeIndex);
+        if (best.size() < query.k) {
+            best.push(candidate);
+        } else if (candidate < best.top()) {
+            best.pop();
+            best.push(candidate);
+        }
+    }
+
+    // Empty the heap, best place first
+    std::vector<Selection<C> > selections(best.size());
+    std::vector<unsigned int> selected(best.size());
+    for (unsigned int selectionIndex = selections.size(); selectionIndex-- > 0; best.pop()) {
+        selections[selectionIndex].id = best.top().second;
+        selections[selectionIndex].loss = best.top().first;
+        selections[selectionIndex].distances.resize(sourcesLength);
+        selected[selectionIndex] = best.top().second;
+    }
+
+    // Search backwards from the selected places, which gives the distance from each branch to them without
+    // touching the graph, in as many passes as it takes to cover the selected places rather than the branches.
+    for (unsigned int batchStart = 0; batchStart < selected.size(); batchStart += batchWidth) {
+        unsigned int batchLength = std::min(batchWidth, (unsigned int) selected.size() - batchStart);
+        search(&selected[batchStart], batchLength, true, &allowed[0], deltaStepping, &distances[0]);
+        for (unsigned int lane = 0; lane < batchLength; lane++) {
+            C placeH = this->places[selected[batchStart + lane]].h;
+            for (unsigned int branchIndex = 0; branchIndex < sourcesLength; branchIndex++) {
+                unsigned int branch = sources[branchIndex];
+                selections[batchStart + lane].distances[branchIndex] = distances[branch * batchWidth + lane] + placeH - this->places[branch].h;
             }
         }
     }
 
-    // Find the encounter place based on total loss.
-    int minimumTotalLoss = INFINITE;
-    int encounterPlaceIndex = -1;
-    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < placesLength; placeIndex++) {
-        if (totalLoss[placeIndex] < minimumTotalLoss) {
-            minimumTotalLoss = totalLoss[placeIndex];
-            encounterPlaceIndex = placeIndex;
+#ifndef BOTNET_SEQUENTIAL
+    if (deltaStepping != NULL) {
+        releaseEngine(deltaStepping, threadsLength);
+    }
+#endif
+    return selections;
+}
+
+#ifndef BOTNET_SEQUENTIAL
+template<class C, class P, template<class> class Q>
+DeltaStepping<C> *Graph<C, P, Q>::acquireEngine(unsigned int threadsLength) const {
+    pthread_mutex_lock(&this->idleEnginesLock);
+    for (unsigned int engineIndex = 0; engineIndex < this->idleEngines.size(); engineIndex++) {
+        if (this->idleEngines[engineIndex].first == threadsLength) {
+            DeltaStepping<C> *deltaStepping = this->idleEngines[engineIndex].second;
+            this->idleEngines.erase(this->idleEngines.begin() + engineIndex);
+            pthread_mutex_unlock(&this->idleEnginesLock);
+            return deltaStepping;
         }
     }
+    pthread_mutex_unlock(&this->idleEnginesLock);
+
+    // Starting the threads and scanning the edges for delta takes a while, so don't hold the lock for it
+    bool pinned = threadsLength == 0;
+    return new DeltaStepping<C>(&this->forward, &this->backward, this->placesLength, this->linksLength,
+                                pinned ? sysconf(_SC_NPROCESSORS_ONLN) : threadsLength, pinned);
+}
+
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::releaseEngine(DeltaStepping<C> *deltaStepping, unsigned int threadsLength) const {
+    pthread_mutex_lock(&this->idleEnginesLock);
+    this->idleEngines.push_back(std::make_pair(threadsLength, deltaStepping));
+    pthread_mutex_unlock(&this->idleEnginesLock);
+}
+#endif
 
-    // Print the output based on the encounter point.
-    if (encounterPlaceIndex == -1) {
-        std::cout << "N" << std::endl;
-    } else {
-        Vertex<Place *> *encounterPlace = places[encounterPlaceIndex];
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::johnson(const Query &query) {
+    // Re-weight the graph so that Dijkstra can run on it.
+    prepare();
 
-        // Transpose the graph
-        transpose();
+    // Find the encounter places based on total loss, and print them.
+    Writer writer(STDOUT_FILENO);
+    printSelections(writer, select(query), this->format);
+}
 
-        // Recalculate distances from the chosen point to each branch
-        dijkstra(encounterPlace);
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::printSelections(Writer &writer, const std::vector<Selection<C> > &selections, Format format) const {
+    if (format == FORMAT_BINARY) {
+        writer.writeBinary((uint32_t) selections.size());
+        for (unsigned int selectionIndex = 0; selectionIndex < selections.size(); selectionIndex++) {
+            const Selection<C> &selection = selections[selectionIndex];
+            writer.writeBinary((uint32_t) selection.id);
+            writer.writeBinary((int64_t) selection.loss);
+            writer.writeBinary((uint32_t) selection.distances.size());
+            for (unsigned int branchIndex = 0; branchIndex < selection.distances.size(); branchIndex++) {
+                writer.writeBinary((int64_t) selection.distances[branchIndex]);
+            }
+        }
+        return;
+    }
 
-        // std::cout << "Found encounter point: " << encounterPlace->element->id << " with total loss " << minimumTotalLoss << std::endl;
-        std::cout << encounterPlace->element->id << " " << minimumTotalLoss << std::endl;
-        for (unsigned int branchIndex = 0; branchIndex < branchesLength; branchIndex++) {
-            Vertex<Place *> *branch = branches[branchIndex];
-            std::cout << branch->distance + encounterPlace->h - branch->h << " ";
-            // std::cout << "Total loss from " << branch->element->id << " to encounter point " << encounterPlace->distance + encounterPlace->h - branch->h << std::endl;
+    if (selections.empty()) {
+        writer.write("N\n", 2);
+    }
+    for (unsigned int selectionIndex = 0; selectionIndex < selections.size(); selectionIndex++) {
+        const Selection<C> &selection = selections[selectionIndex];
+        writer.writeInteger(selection.id);
+        writer.write(' ');
+        writer.writeInteger(selection.loss);
+        writer.write('\n');
+        for (unsigned int branchIndex = 0; branchIndex < selection.distances.size(); branchIndex++) {
+            writer.writeInteger(selection.distances[branchIndex]);
+            writer.write(' ');
         }
-        std::cout << std::endl;
+        writer.write('\n');
     }
 }
 
-Graph::~Graph() {
-    delete[] this->branches;
-    for (unsigned int i = 0; i < this->placesLength; ++i) {
-        delete this->places[i];
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::clear() {
+    for (unsigned int placeIndex = 0; placeIndex < this->places.size(); placeIndex++) {
+        this->places[placeIndex].release();
     }
-    delete[] this->places;
+    this->places.clear();
+    this->reweighted = false;
+#ifndef BOTNET_SEQUENTIAL
+    // Engines were made for the old edges
+    for (unsigned int engineIndex = 0; engineIndex < this->idleEngines.size(); engineIndex++) {
+        delete this->idleEngines[engineIndex].second;
+    }
+    this->idleEngines.clear();
+#endif
+}
+
+template<class C, class P, template<class> class Q>
+Graph<C, P, Q>::~Graph() {
+    clear();
+#ifndef BOTNET_SEQUENTIAL
+    pthread_mutex_destroy(&this->idleEnginesLock);
+#endif
 }
+
+// The cost type and payload are picked by the build, both queue policies get compiled
+template class Graph<Cost, Payload, BinaryHeap>;
+template class Graph<Cost, Payload, QuaternaryHeap>;
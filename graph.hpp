@@ -1,89 +1,261 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
-#include <stack>
-#include <map>
-#include <list>
 #include <vector>
+#include <iostream>
 #include <limits>
-#include <queue>
-#include "branch.hpp"
-#include "place.hpp"
+#include <utility>
+#include <stdint.h>
+#include "payload.hpp"
+#include "queue.hpp"
+#include "writer.hpp"
+
+// The sequential build (mooshak's) has no delta-stepping, threads or placement policies, so it only needs the standard
+// library. Its arrays come from the plain allocator.
+#ifdef BOTNET_SEQUENTIAL
+#define GRAPH_ALLOCATOR std::allocator
+#else
+#include <pthread.h>
+#include "placement.hpp"
+#define GRAPH_ALLOCATOR PlacementAllocator
+#endif
 
-#define INFINITE std::numeric_limits<int>::max()
 #define S_INDEX 0
 #define PLACES_START_INDEX 1
+#ifndef BATCH_WIDTH
+#define BATCH_WIDTH 8
+#endif
+#define DELTA_STEPPING_MIN_PLACES 10000
+
+// Set of lanes of a batch, one bit per lane, so it must be at least BATCH_WIDTH bits wide.
+#if BATCH_WIDTH <= 8
+typedef uint8_t LaneMask;
+#elif BATCH_WIDTH <= 16
+typedef uint16_t LaneMask;
+#elif BATCH_WIDTH <= 32
+typedef uint32_t LaneMask;
+#else
+#error "BATCH_WIDTH can be at most 32"
+#endif
+
+enum Engine {
+    ENGINE_AUTO,            // Picks one of the others based on the size of the graph and the number of cores.
+    ENGINE_DIJKSTRA,        // Sequential (batched) dijkstra.
+    ENGINE_DELTA_STEPPING   // Parallel delta-stepping, one source at a time.
+};
 
-template<class T>
-class Vertex;
+enum Objective {
+    OBJECTIVE_SUM,          // Sum of the losses of every branch (the project's original objective).
+    OBJECTIVE_MINIMAX,      // Loss of the branch that loses the most.
+    OBJECTIVE_WEIGHTED_SUM  // Sum of the losses of every branch, each multiplied by its weight.
+};
 
-template<class T>
+class Query {
+public:
+    std::vector<unsigned int> branches;    // Place ids of the branches meeting, empty for the graph's branches.
+    std::vector<unsigned int> candidates;  // Place ids allowed as meeting points, empty for every place.
+    bool branchesOnly;                     // Only allows the query's branches as meeting points, overrides candidates.
+    std::vector<int> weights;              // Weight of each branch, for OBJECTIVE_WEIGHTED_SUM (missing weights are 1).
+    Objective objective;
+    Engine engine;                         // Shortest path engine for this query, ENGINE_AUTO for the graph's own setting.
+    unsigned int k;                        // Number of meeting points to select.
+
+    Query();                               // Creates a query for the single best meeting point of the graph's branches.
+};
+
+template<class C>
+class Selection {
+public:
+    unsigned int id;                       // Place id of the meeting point.
+    C loss;                                // Value of the objective at the meeting point.
+    std::vector<C> distances;              // Loss of each branch of the query to get to the meeting point.
+};
+
+template<class C>
+class DeltaStepping;
+
+template<class C>
 class Edge {
 public:
-    Vertex<T> *vertex;
-    int cost;
+    unsigned int vertex;                   // Index of the vertex at the other end.
+    C cost;
+};
+
+/**
+ * Edges of every vertex, packed in a single array: the edges of vertex v are edges[starts[v]] up to edges[starts[v + 1]].
+ * Both arrays are allocated following the Placement policies, or from the heap in the sequential build.
+ */
+template<class C>
+class Adjacency {
+public:
+    std::vector<unsigned int, GRAPH_ALLOCATOR<unsigned int> > starts;
+    std::vector<Edge<C>, GRAPH_ALLOCATOR<Edge<C> > > edges;
+};
 
-    Edge(Vertex<T> *const vertex, int cost);           // Creates a new edge.
-    virtual ~Edge();                                   // Deconstructs a edge.
+/**
+ * Strongly connected components of the places, numbered in the order tarjan's algorithm finds them, which is reverse
+ * topological: edges between components always go from a higher number to a lower one.
+ */
+class Condensation {
+public:
+    std::vector<unsigned int> components;  // Component of each place.
+    unsigned int componentsLength;
+    std::vector<unsigned int> starts;      // Components reached by edges of component c are successors[starts[c]] up to successors[starts[c + 1]].
+    std::vector<unsigned int> successors;
 };
 
-template<class T>
-class Vertex {
+template<class C, class P>
+class Vertex : public P {
 public:
-    T element;
-    Vertex *parent;
-    int distance;
-    int h;
-    std::list<Edge<T> *> edges;
-
-    Vertex(T element);                                   // Creates a new vertex.
-    void reset();                                        // Resets a vertex to its initial state.
-    void addLink(Vertex<T> *const vertex, int cost);     // Connects the vertex with another one.
-    void saveDistance();                                 // Saves distance field in h field.
-    std::list<Edge<T> *> &getEdges();                       // Returns the edges
-    bool operator < (const Vertex<T>* const &v) const;   // Comparator for distances
-    virtual ~Vertex();                                   // Deconstructs a vertex.
+    C h;                                   // Distance from s, used to re-weight the edges.
+
+    Vertex(unsigned int id);               // Creates a new vertex.
 };
 
+/**
+ * Graph of places, templated on the cost type C, the payload policy P of the vertices and the queue policy Q that
+ * orders the buckets of the dijkstra searches. Edges are stored in both directions, so that distances to a place can
+ * be found as easily as distances from it.
+ */
+template<class C, class P, template<class> class Q>
 class Graph {
-    Vertex<Place *> **branches;
-    unsigned int branchesLength;
-    Vertex<Place *> **places;
+    std::vector<unsigned int> branches;
+    std::vector<Vertex<C, P>, GRAPH_ALLOCATOR<Vertex<C, P> > > places;
     unsigned int placesLength;
+    unsigned int linksLength;
+    Adjacency<C> forward;
+    Adjacency<C> backward;
+    Condensation condensation;
+    Engine engine;
+    Format format;
+    bool reweighted;
+    C maximumCost;                         // Cost of the most expensive edge, once re-weighted.
+    C bucketWidth;                         // Range of distances each bucket of the batched dijkstra holds.
+
+#ifndef BOTNET_SEQUENTIAL
+    // Delta-stepping engines no query is using, with the number of threads each was asked for.
+    // Engines keep their threads between runs, so they're reused rather than started again for every query.
+    mutable std::vector<std::pair<unsigned int, DeltaStepping<C> *> > idleEngines;
+    mutable pthread_mutex_t idleEnginesLock;
+#endif
 
 public:
-    Graph();               // Creates a new graph.
-    void populate();       // Populates the graph with the given input.
-    void execute();        // Executes the algorithm.
-    void print() const;    // Prints the graph.
-    virtual ~Graph();      // Deconstructs a graph.
+    Graph();                                          // Creates a new graph.
+    void populate(std::istream &input = std::cin);    // Populates the graph with the given input, replacing what it held.
+    void setEngine(Engine engine);                    // Sets the shortest path engine of queries that leave it to the graph.
+    void setFormat(Format format);                    // Sets the format of the results printed by execute.
+    void prepare();                                   // Re-weights and condenses the graph so that it can be queried with select.
+    void execute(const Query &query = Query());       // Executes the algorithm.
+    std::vector<unsigned int> getBranches() const;    // Returns the place ids of the graph's branches.
+    unsigned int getPlacesLength() const;             // Returns the number of places, which are numbered from 1.
+    void print() const;                               // Prints the graph.
+    virtual ~Graph();                                 // Deconstructs a graph.
+
+    /**
+     * Selects the k best meeting points of a query, best first, along with each branch's loss to get to them.
+     * Places some branch can't reach are never selected. The graph must have been prepared.
+     * Delta-stepping uses up to threadsLength threads, 0 meaning every core. Only queries given every core get their
+     * threads pinned, as queries running side by side would otherwise all be pinned to the same processors.
+     */
+    std::vector<Selection<C> > select(const Query &query, unsigned int threadsLength = 0) const;
+
+    /**
+     * Prints selected meeting points. As text, that's the project's output format, or "N" if there are none.
+     * As binary, it's the number of meeting points (uint32), then for each of them its id (uint32), loss (int64),
+     * number of branches (uint32) and each branch's loss (int64).
+     */
+    void printSelections(Writer &writer, const std::vector<Selection<C> > &selections, Format format) const;
 
 private:
+    // Graphs own their places' payloads and their engines, so they can't be copied.
+    Graph(const Graph &other);
+    Graph &operator=(const Graph &other);
+
+    void clear();  // Releases the places and the idle engines, so that the graph can be populated again.
+
+    /**
+     * Runs bellman-ford algorithm from s, which has an edge with cost 0 to every place, and saves the distances in the h field.
+     */
+    void bellmanFord();
+
     /**
-     * Runs bellman-ford algorithm in the source and updates the graph distance and parent values of all vertexes.
+     * Finds the strongly connected components of the places with an iterative tarjan, and the edges between them.
      */
-    bool bellmanFord(Vertex<Place *> *source);
+    void condense();
 
     /**
-     * Runs dijkstra's algorithm on the graph (only on branches)
+     * Finds the places worth searching for a query: those that can reach a candidate every source can reach, as no
+     * shortest path to a valid meeting point goes through any other place. Works on the condensation, propagating
+     * which sources reach each component 64 sources at a time. Returns false, without filling allowed, if there is
+     * no valid meeting point at all.
      */
-    void dijkstra(Vertex<Place *> *source);
+    bool prune(const std::vector<unsigned int> &sources, const std::vector<unsigned int> &candidates, bool everyPlace, std::vector<char, GRAPH_ALLOCATOR<char> > &allowed) const;
 
     /**
-     * Transposes the graph
+     * Runs up to BATCH_WIDTH dijkstra searches in lockstep, one per source, over a single pass of the edges.
+     * Distances are stored BATCH_WIDTH-wide per vertex, so the distance of place p from sources[k] ends up
+     * in distances[p * BATCH_WIDTH + k].
+     * Places are kept in buckets of bucketWidth by the smallest of their lanes not expanded yet, rather than in a heap,
+     * and expanding a place relaxes only those lanes. The numbers of the buckets holding places are ordered with Q.
+     * When reversed, edges are followed backwards, giving the distances from every place to the sources.
+     * Only places marked in allowed are visited, the others are left at infinite.
+     * Edge costs must be non-negative (i.e. already re-weighted).
      */
-    void transpose();
+    void batchedDijkstra(const unsigned int *sources, unsigned int sourcesLength, bool reversed, const char *allowed, C *distances) const;
 
     /**
-     * Reconstructs a path based on parent values of the graph, from a given destination.
-     * Be sure to reconstruct only if the parent values are correct.
+     * Runs one batch of searches with the batched dijkstra, or a single search with delta-stepping if one is given.
+     * Distances are laid out as in batchedDijkstra, with a width of 1 for delta-stepping.
      */
-    std::list<Vertex<Place *> *> path(Vertex<Place *> *destination);
+    void search(const unsigned int *sources, unsigned int sourcesLength, bool reversed, const char *allowed, DeltaStepping<C> *deltaStepping, C *distances) const;
+
+#ifndef BOTNET_SEQUENTIAL
+    /**
+     * Takes an idle delta-stepping engine asked for threadsLength threads (0 for every core, pinned), or starts a new
+     * one if there is none.
+     * It must be handed back with releaseEngine once the query is done with it.
+     */
+    DeltaStepping<C> *acquireEngine(unsigned int threadsLength) const;
+    void releaseEngine(DeltaStepping<C> *deltaStepping, unsigned int threadsLength) const;
+#endif
+
+    /**
+     * Resolves ENGINE_AUTO for a fan-out from sourcesLength sources, with threadsLength threads available.
+     * Delta-stepping pays off when the graph is big enough to keep every thread busy and there are too few sources
+     * for batching to amortize much, i.e. when ceil(sources / BATCH_WIDTH) batched passes take longer than
+     * sources parallel passes at roughly half the threads' worth of speedup.
+     * The sequential build always picks the batched dijkstra.
+     */
+    Engine chooseEngine(unsigned int sourcesLength, unsigned int threadsLength) const;
 
     /**
      * Runs johnson's algorithm on the graph (only on branches) and prints the output of the project.
      */
-    void johnson();
+    void johnson(const Query &query);
 };
 
+//
+// Build configuration, picked with -D flags by the Makefile targets.
+//
+
+#ifdef BOTNET_COST_64
+typedef int64_t Cost;
+#else
+typedef int32_t Cost;
+#endif
+
+#if defined(BOTNET_PAYLOAD_RICH)
+typedef PlacePayload Payload;
+#elif defined(BOTNET_PAYLOAD_ID)
+typedef IdPayload Payload;
+#else
+typedef NoPayload Payload;
+#endif
+
+#ifdef BOTNET_QUEUE_QUATERNARY
+typedef Graph<Cost, Payload, QuaternaryHeap> BotnetGraph;
+#else
+typedef Graph<Cost, Payload, BinaryHeap> BotnetGraph;
+#endif
+
 #endif //GRAPH_H
@@ -0,0 +1,14 @@
+#include "graph.hpp"
+
+//
+// Entry point of the mooshak build, which only reads the project's input from stdin and prints its output.
+// Options, the server and the verifier are left out.
+//
+
+int main() {
+    BotnetGraph *graph = new BotnetGraph();
+    graph->populate();
+    graph->execute();
+    delete graph;
+    return 0;
+}
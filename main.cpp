@@ -1,10 +1,133 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
 #include "graph.hpp"
+#include "server.hpp"
+#include "client.hpp"
+#include "verifier.hpp"
+#include "benchmark.hpp"
+
+int main(int argc, char **argv) {
+    BotnetGraph *graph = new BotnetGraph();
+    Query query;
+    const char *serverPath = NULL;
+    const char *clientPath = NULL;
+    unsigned int verifierRounds = 0;
+    unsigned int workersLength = sysconf(_SC_NPROCESSORS_ONLN);
+    PagePolicy pages = PAGES_DEFAULT;
+    NodePolicy nodes = NODES_DEFAULT;
+    bool pinning = false;
+    bool timing = false;
+    bool binary = false;
+
+    // -e picks the shortest path engine: dijkstra, delta or auto (default)
+    // -k asks for the k best meeting points instead of just the best one
+    // -o picks the objective: sum (default), minimax or weighted, which reads one weight per branch after the connections
+    // -c branches only lets places with a branch be meeting points
+    // -s path loads the graph and then answers queries on the unix socket at path, with -w workers (one per core by default)
+    // -b prints the results in binary instead of text (see Graph::printSelections), not with -s as answers are lines of text
+    // -q path sends the queries on the standard input to the server at path, and prints the answers
+    // -t rounds checks the engines against a slow reference on that many random graphs, instead of reading one
+    // -l picks the pages of the graph and search arrays: default, transparent (huge pages) or explicit (from the huge page pool)
+    // -n interleave spreads the graph and search arrays over every NUMA node
+    // -p pins every thread to its own processor
+    // -T prints how long each stage took, and its page faults, to the standard error
+    int option;
+    bool valid = true;
+    while ((option = getopt(argc, argv, "e:k:o:c:bs:w:q:t:l:n:pT")) != -1) {
+        if (option == 'e' && strcmp(optarg, "dijkstra") == 0) {
+            graph->setEngine(ENGINE_DIJKSTRA);
+        } else if (option == 'e' && strcmp(optarg, "delta") == 0) {
+            graph->setEngine(ENGINE_DELTA_STEPPING);
+        } else if (option == 'e' && strcmp(optarg, "auto") == 0) {
+            graph->setEngine(ENGINE_AUTO);
+        } else if (option == 'k' && atoi(optarg) > 0) {
+            query.k = atoi(optarg);
+        } else if (option == 'o' && strcmp(optarg, "sum") == 0) {
+            query.objective = OBJECTIVE_SUM;
+        } else if (option == 'o' && strcmp(optarg, "minimax") == 0) {
+            query.objective = OBJECTIVE_MINIMAX;
+        } else if (option == 'o' && strcmp(optarg, "weighted") == 0) {
+            query.objective = OBJECTIVE_WEIGHTED_SUM;
+        } else if (option == 'c' && strcmp(optarg, "branches") == 0) {
+            query.branchesOnly = true;
+        } else if (option == 'b') {
+            graph->setFormat(FORMAT_BINARY);
+            binary = true;
+        } else if (option == 's') {
+            serverPath = optarg;
+        } else if (option == 'w' && atoi(optarg) > 0) {
+            workersLength = atoi(optarg);
+        } else if (option == 'q') {
+            clientPath = optarg;
+        } else if (option == 't' && atoi(optarg) > 0) {
+            verifierRounds = atoi(optarg);
+        } else if (option == 'l' && strcmp(optarg, "default") == 0) {
+            pages = PAGES_DEFAULT;
+        } else if (option == 'l' && strcmp(optarg, "transparent") == 0) {
+            pages = PAGES_TRANSPARENT;
+        } else if (option == 'l' && strcmp(optarg, "explicit") == 0) {
+            pages = PAGES_EXPLICIT;
+        } else if (option == 'n' && strcmp(optarg, "default") == 0) {
+            nodes = NODES_DEFAULT;
+        } else if (option == 'n' && strcmp(optarg, "interleave") == 0) {
+            nodes = NODES_INTERLEAVE;
+        } else if (option == 'p') {
+            pinning = true;
+        } else if (option == 'T') {
+            timing = true;
+        } else {
+            valid = false;
+        }
+    }
+    if (binary && serverPath != NULL) {
+        std::cerr << "The server only answers in text, -b can't be used with -s" << std::endl;
+        valid = false;
+    }
+    if (!valid) {
+        std::cerr << "Usage: " << argv[0] << " [-e dijkstra|delta|auto] [-k count] [-o sum|minimax|weighted] [-c branches] [-b] [-l default|transparent|explicit] [-n default|interleave] [-p] [-T] [-s path [-w workers] | -q path | -t rounds]" << std::endl;
+        delete graph;
+        return 1;
+    }
+
+    if (verifierRounds > 0) {
+        Verifier verifier(verifierRounds);
+        delete graph;
+        return verifier.run() ? 0 : 1;
+    }
+
+    if (clientPath != NULL) {
+        Client client(clientPath);
+        delete graph;
+        return client.run() ? 0 : 1;
+    }
+
+    // The policies apply from here on. The main thread takes the first processor, as it's also delta-stepping's thread 0
+    Placement::configure(pages, nodes, pinning, timing);
+    Placement::pin(pthread_self(), 0);
+    Benchmark benchmark(timing);
 
-int main() {
-    Graph *graph = new Graph();
     graph->populate();
-    graph->execute();
+    benchmark.lap("populate");
+    if (query.objective == OBJECTIVE_WEIGHTED_SUM) {
+        query.weights.resize(graph->getBranches().size());
+        for (unsigned int branchIndex = 0; branchIndex < query.weights.size(); branchIndex++) {
+            std::cin >> query.weights[branchIndex];
+        }
+    }
+    if (serverPath != NULL) {
+        Server server(graph, query, serverPath, workersLength);
+        bool served = server.serve();
+        delete graph;
+        return served ? 0 : 1;
+    }
+
+    // Preparing happens in execute anyway, but doing it first lets it be timed on its own
+    graph->prepare();
+    benchmark.lap("prepare");
+    graph->execute(query);
+    benchmark.lap("execute");
     delete graph;
     return 0;
 }
@@ -0,0 +1,40 @@
+#
+# Pastes the library's sources into a single file for mooshak (see the Makefile), keeping only the sequential build:
+# the project's own includes are dropped, as their contents are pasted in order, and so is everything guarded out by
+# BOTNET_SEQUENTIAL, which leaves delta-stepping, threads and placement out of the file.
+#
+
+/^#include "/ {
+    next
+}
+
+# Track every conditional, remembering which ones test BOTNET_SEQUENTIAL and whether their current branch is kept
+/^#if/ {
+    depth++
+    if ($0 ~ /BOTNET_SEQUENTIAL/) {
+        sequential[depth] = 1
+        kept[depth] = $1 == "#ifdef"
+        next
+    }
+}
+/^#else/ && sequential[depth] {
+    kept[depth] = !kept[depth]
+    next
+}
+/^#endif/ {
+    if (sequential[depth]) {
+        sequential[depth] = 0
+        depth--
+        next
+    }
+    depth--
+}
+
+{
+    for (level = 1; level <= depth; level++) {
+        if (sequential[level] && !kept[level]) {
+            next
+        }
+    }
+    print
+}
@@ -1,389 +1,1222 @@
-#include <iostream>
-#include <list>
-#include <limits>
-#include <queue>
+// Generated by make mooshak.cpp from branch.hpp place.hpp payload.hpp queue.hpp writer.hpp graph.hpp branch.cpp place.cpp writer.cpp graph.cpp judge.cpp, do not edit.
+#ifndef BRANCH_H
+#define BRANCH_H
+
+
+class Branch {
+
+};
+
+
+#endif //BRANCH_H
+#ifndef PLACE_H
+#define PLACE_H
 
-#define INFINITE std::numeric_limits<int>::max()
-#define S_INDEX 0
-#define PLACES_START_INDEX 1
 
 class Place {
 public:
     unsigned int id;
+    Branch *branch;
 
+    Place(unsigned int id, Branch *const branch);
     Place(unsigned int id);
     virtual ~Place();
 };
 
+
+#endif //PLACE_H
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <ostream>
+
+//
+// Payload policies, i.e. what a vertex carries besides what the algorithm needs.
+// Vertices inherit from their payload, so an empty payload takes no space at all.
+//
+
+// Carries nothing, the place id is the vertex's index in the graph.
+class NoPayload {
+public:
+    NoPayload(unsigned int id) {}
+    void setBranch() {}
+    void release() {}
+    void describe(std::ostream &output) const {}
+};
+
+// Carries the place id.
+class IdPayload {
+public:
+    unsigned int id;
+
+    IdPayload(unsigned int id) : id(id) {}
+    void setBranch() {}
+    void release() {}
+    void describe(std::ostream &output) const {
+        output << " with id " << this->id;
+    }
+};
+
+// Carries a full place, and its branch if it has one.
+class PlacePayload {
+public:
+    Place *place;
+
+    PlacePayload(unsigned int id) : place(new Place(id)) {}
+    void setBranch() {
+        if (this->place->branch == NULL) {
+            this->place->branch = new Branch();
+        }
+    }
+    void release() {
+        delete this->place;
+    }
+    void describe(std::ostream &output) const {
+        output << " has branch? " << (this->place->branch != NULL);
+    }
+};
+
+#endif //PAYLOAD_H
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+//
+// Queue policies for the dijkstra searches. Both are min-heaps: the smallest element is on top.
+//
+
 template<class T>
-class Vertex;
+class BinaryHeap {
+    std::vector<T> heap;
 
+public:
+    bool empty() const {
+        return this->heap.empty();
+    }
+
+    const T &top() const {
+        return this->heap.front();
+    }
+
+    void push(const T &element) {
+        this->heap.push_back(element);
+        std::push_heap(this->heap.begin(), this->heap.end(), std::greater<T>());
+    }
+
+    void pop() {
+        std::pop_heap(this->heap.begin(), this->heap.end(), std::greater<T>());
+        this->heap.pop_back();
+    }
+};
+
+/**
+ * Heap where every node has 4 children. It's half as deep as a binary heap and a node's children share a cache line,
+ * which makes pushes cheaper at the cost of a few more comparisons per pop.
+ */
 template<class T>
+class QuaternaryHeap {
+    std::vector<T> heap;
+
+public:
+    bool empty() const {
+        return this->heap.empty();
+    }
+
+    const T &top() const {
+        return this->heap.front();
+    }
+
+    void push(const T &element) {
+        // Move the element up while it's smaller than its parent
+        unsigned int index = this->heap.size();
+        this->heap.push_back(element);
+        while (index > 0) {
+            unsigned int parent = (index - 1) / 4;
+            if (!(element < this->heap[parent])) {
+                break;
+            }
+            this->heap[index] = this->heap[parent];
+            index = parent;
+        }
+        this->heap[index] = element;
+    }
+
+    void pop() {
+        // Move the last element down from the top while one of its children is smaller
+        T element = this->heap.back();
+        this->heap.pop_back();
+        unsigned int length = this->heap.size();
+        if (length == 0) {
+            return;
+        }
+        unsigned int index = 0;
+        while (true) {
+            unsigned int first = index * 4 + 1;
+            if (first >= length) {
+                break;
+            }
+            unsigned int smallest = first;
+            for (unsigned int child = first + 1; child < first + 4 && child < length; child++) {
+                if (this->heap[child] < this->heap[smallest]) {
+                    smallest = child;
+                }
+            }
+            if (!(this->heap[smallest] < element)) {
+                break;
+            }
+            this->heap[index] = this->heap[smallest];
+            index = smallest;
+        }
+        this->heap[index] = element;
+    }
+};
+
+#endif //QUEUE_H
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdint.h>
+
+#define WRITER_CAPACITY 65536
+
+enum Format {
+    FORMAT_TEXT,    // The project's output format.
+    FORMAT_BINARY   // Fixed size fields in the machine's byte order, for tools that read the results back.
+};
+
+/**
+ * Buffers output for a file descriptor, and hands it to the kernel with a single write() whenever the buffer fills up
+ * or is flushed. Integers are converted to text by hand, two digits at a time.
+ */
+class Writer {
+    int descriptor;
+    char *buffer;
+    unsigned int length;
+    unsigned int capacity;
+    bool failed;
+
+public:
+    Writer(int descriptor, unsigned int capacity = WRITER_CAPACITY);  // Creates a writer for an open file descriptor.
+    void write(const char *data, unsigned int length);                 // Writes raw bytes.
+    void write(char character);                                        // Writes a single character.
+    void writeInteger(int64_t value);                                  // Writes an integer as text.
+    void writeBinary(uint32_t value);                                  // Writes an integer as 4 raw bytes.
+    void writeBinary(int64_t value);                                   // Writes an integer as 8 raw bytes.
+    bool flush();                                                      // Writes out the buffer, returns false on errors.
+    virtual ~Writer();                                                 // Flushes and deconstructs a writer.
+};
+
+#endif //WRITER_H
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <vector>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <stdint.h>
+
+// The sequential build (mooshak's) has no delta-stepping, threads or placement policies, so it only needs the standard
+// library. Its arrays come from the plain allocator.
+#define GRAPH_ALLOCATOR std::allocator
+
+#define S_INDEX 0
+#define PLACES_START_INDEX 1
+#ifndef BATCH_WIDTH
+#define BATCH_WIDTH 8
+#endif
+#define DELTA_STEPPING_MIN_PLACES 10000
+
+// Set of lanes of a batch, one bit per lane, so it must be at least BATCH_WIDTH bits wide.
+#if BATCH_WIDTH <= 8
+typedef uint8_t LaneMask;
+#elif BATCH_WIDTH <= 16
+typedef uint16_t LaneMask;
+#elif BATCH_WIDTH <= 32
+typedef uint32_t LaneMask;
+#else
+#error "BATCH_WIDTH can be at most 32"
+#endif
+
+enum Engine {
+    ENGINE_AUTO,            // Picks one of the others based on the size of the graph and the number of cores.
+    ENGINE_DIJKSTRA,        // Sequential (batched) dijkstra.
+    ENGINE_DELTA_STEPPING   // Parallel delta-stepping, one source at a time.
+};
+
+enum Objective {
+    OBJECTIVE_SUM,          // Sum of the losses of every branch (the project's original objective).
+    OBJECTIVE_MINIMAX,      // Loss of the branch that loses the most.
+    OBJECTIVE_WEIGHTED_SUM  // Sum of the losses of every branch, each multiplied by its weight.
+};
+
+class Query {
+public:
+    std::vector<unsigned int> branches;    // Place ids of the branches meeting, empty for the graph's branches.
+    std::vector<unsigned int> candidates;  // Place ids allowed as meeting points, empty for every place.
+    bool branchesOnly;                     // Only allows the query's branches as meeting points, overrides candidates.
+    std::vector<int> weights;              // Weight of each branch, for OBJECTIVE_WEIGHTED_SUM (missing weights are 1).
+    Objective objective;
+    Engine engine;                         // Shortest path engine for this query, ENGINE_AUTO for the graph's own setting.
+    unsigned int k;                        // Number of meeting points to select.
+
+    Query();                               // Creates a query for the single best meeting point of the graph's branches.
+};
+
+template<class C>
+class Selection {
+public:
+    unsigned int id;                       // Place id of the meeting point.
+    C loss;                                // Value of the objective at the meeting point.
+    std::vector<C> distances;              // Loss of each branch of the query to get to the meeting point.
+};
+
+template<class C>
+class DeltaStepping;
+
+template<class C>
 class Edge {
 public:
-    Vertex<T> *vertex;
-    int cost;
+    unsigned int vertex;                   // Index of the vertex at the other end.
+    C cost;
+};
+
+/**
+ * Edges of every vertex, packed in a single array: the edges of vertex v are edges[starts[v]] up to edges[starts[v + 1]].
+ * Both arrays are allocated following the Placement policies, or from the heap in the sequential build.
+ */
+template<class C>
+class Adjacency {
+public:
+    std::vector<unsigned int, GRAPH_ALLOCATOR<unsigned int> > starts;
+    std::vector<Edge<C>, GRAPH_ALLOCATOR<Edge<C> > > edges;
+};
 
-    Edge(Vertex<T> *const vertex, int cost);           // Creates a new edge.
-    virtual ~Edge();                                   // Deconstructs a edge.
+/**
+ * Strongly connected components of the places, numbered in the order tarjan's algorithm finds them, which is reverse
+ * topological: edges between components always go from a higher number to a lower one.
+ */
+class Condensation {
+public:
+    std::vector<unsigned int> components;  // Component of each place.
+    unsigned int componentsLength;
+    std::vector<unsigned int> starts;      // Components reached by edges of component c are successors[starts[c]] up to successors[starts[c + 1]].
+    std::vector<unsigned int> successors;
 };
 
-template<class T>
-class Vertex {
+template<class C, class P>
+class Vertex : public P {
 public:
-    T element;
-    int distance;
-    int h;
-    std::list<Edge<T> > edges;
-
-    Vertex(T element);                                   // Creates a new vertex.
-    void reset();                                        // Resets a vertex to its initial state.
-    void addLink(Vertex<T> *const vertex, int cost);     // Connects the vertex with another one.
-    void saveDistance();                                 // Saves distance field in h field.
-    std::list<Edge<T> > &getEdges();                     // Returns the edges
-    virtual ~Vertex();                                   // Deconstructs a vertex.
+    C h;                                   // Distance from s, used to re-weight the edges.
+
+    Vertex(unsigned int id);               // Creates a new vertex.
 };
 
+/**
+ * Graph of places, templated on the cost type C, the payload policy P of the vertices and the queue policy Q that
+ * orders the buckets of the dijkstra searches. Edges are stored in both directions, so that distances to a place can
+ * be found as easily as distances from it.
+ */
+template<class C, class P, template<class> class Q>
 class Graph {
-    Vertex<Place *> **branches;
-    unsigned int branchesLength;
-    Vertex<Place *> **places;
+    std::vector<unsigned int> branches;
+    std::vector<Vertex<C, P>, GRAPH_ALLOCATOR<Vertex<C, P> > > places;
     unsigned int placesLength;
+    unsigned int linksLength;
+    Adjacency<C> forward;
+    Adjacency<C> backward;
+    Condensation condensation;
+    Engine engine;
+    Format format;
+    bool reweighted;
+    C maximumCost;                         // Cost of the most expensive edge, once re-weighted.
+    C bucketWidth;                         // Range of distances each bucket of the batched dijkstra holds.
+
 
 public:
-    Graph();               // Creates a new graph.
-    void populate();       // Populates the graph with the given input.
-    void execute();        // Executes the algorithm.
-    void print() const;    // Prints the graph.
-    virtual ~Graph();      // Deconstructs a graph.
+    Graph();                                          // Creates a new graph.
+    void populate(std::istream &input = std::cin);    // Populates the graph with the given input, replacing what it held.
+    void setEngine(Engine engine);                    // Sets the shortest path engine of queries that leave it to the graph.
+    void setFormat(Format format);                    // Sets the format of the results printed by execute.
+    void prepare();                                   // Re-weights and condenses the graph so that it can be queried with select.
+    void execute(const Query &query = Query());       // Executes the algorithm.
+    std::vector<unsigned int> getBranches() const;    // Returns the place ids of the graph's branches.
+    unsigned int getPlacesLength() const;             // Returns the number of places, which are numbered from 1.
+    void print() const;                               // Prints the graph.
+    virtual ~Graph();                                 // Deconstructs a graph.
+
+    /**
+     * Selects the k best meeting points of a query, best first, along with each branch's loss to get to them.
+     * Places some branch can't reach are never selected. The graph must have been prepared.
+     * Delta-stepping uses up to threadsLength threads, 0 meaning every core. Only queries given every core get their
+     * threads pinned, as queries running side by side would otherwise all be pinned to the same processors.
+     */
+    std::vector<Selection<C> > select(const Query &query, unsigned int threadsLength = 0) const;
+
+    /**
+     * Prints selected meeting points. As text, that's the project's output format, or "N" if there are none.
+     * As binary, it's the number of meeting points (uint32), then for each of them its id (uint32), loss (int64),
+     * number of branches (uint32) and each branch's loss (int64).
+     */
+    void printSelections(Writer &writer, const std::vector<Selection<C> > &selections, Format format) const;
 
 private:
-    // Runs Bellman-Ford algorithm in the source and updates the graph distance of all vertices.
-    bool bellmanFord(Vertex<Place *> *source);
+    // Graphs own their places' payloads and their engines, so they can't be copied.
+    Graph(const Graph &other);
+    Graph &operator=(const Graph &other);
+
+    void clear();  // Releases the places and the idle engines, so that the graph can be populated again.
+
+    /**
+     * Runs bellman-ford algorithm from s, which has an edge with cost 0 to every place, and saves the distances in the h field.
+     */
+    void bellmanFord();
+
+    /**
+     * Finds the strongly connected components of the places with an iterative tarjan, and the edges between them.
+     */
+    void condense();
+
+    /**
+     * Finds the places worth searching for a query: those that can reach a candidate every source can reach, as no
+     * shortest path to a valid meeting point goes through any other place. Works on the condensation, propagating
+     * which sources reach each component 64 sources at a time. Returns false, without filling allowed, if there is
+     * no valid meeting point at all.
+     */
+    bool prune(const std::vector<unsigned int> &sources, const std::vector<unsigned int> &candidates, bool everyPlace, std::vector<char, GRAPH_ALLOCATOR<char> > &allowed) const;
 
-    // Runs Dijkstra's algorithm on the graph (only on branches).
-    void dijkstra(Vertex<Place *> *source);
+    /**
+     * Runs up to BATCH_WIDTH dijkstra searches in lockstep, one per source, over a single pass of the edges.
+     * Distances are stored BATCH_WIDTH-wide per vertex, so the distance of place p from sources[k] ends up
+     * in distances[p * BATCH_WIDTH + k].
+     * Places are kept in buckets of bucketWidth by the smallest of their lanes not expanded yet, rather than in a heap,
+     * and expanding a place relaxes only those lanes. The numbers of the buckets holding places are ordered with Q.
+     * When reversed, edges are followed backwards, giving the distances from every place to the sources.
+     * Only places marked in allowed are visited, the others are left at infinite.
+     * Edge costs must be non-negative (i.e. already re-weighted).
+     */
+    void batchedDijkstra(const unsigned int *sources, unsigned int sourcesLength, bool reversed, const char *allowed, C *distances) const;
 
-    // Transposes the graph.
-    void transpose();
+    /**
+     * Runs one batch of searches with the batched dijkstra, or a single search with delta-stepping if one is given.
+     * Distances are laid out as in batchedDijkstra, with a width of 1 for delta-stepping.
+     */
+    void search(const unsigned int *sources, unsigned int sourcesLength, bool reversed, const char *allowed, DeltaStepping<C> *deltaStepping, C *distances) const;
+
+
+    /**
+     * Resolves ENGINE_AUTO for a fan-out from sourcesLength sources, with threadsLength threads available.
+     * Delta-stepping pays off when the graph is big enough to keep every thread busy and there are too few sources
+     * for batching to amortize much, i.e. when ceil(sources / BATCH_WIDTH) batched passes take longer than
+     * sources parallel passes at roughly half the threads' worth of speedup.
+     * The sequential build always picks the batched dijkstra.
+     */
+    Engine chooseEngine(unsigned int sourcesLength, unsigned int threadsLength) const;
+
+    /**
+     * Runs johnson's algorithm on the graph (only on branches) and prints the output of the project.
+     */
+    void johnson(const Query &query);
 };
 
+//
+// Build configuration, picked with -D flags by the Makefile targets.
+//
+
+#ifdef BOTNET_COST_64
+typedef int64_t Cost;
+#else
+typedef int32_t Cost;
+#endif
+
+#if defined(BOTNET_PAYLOAD_RICH)
+typedef PlacePayload Payload;
+#elif defined(BOTNET_PAYLOAD_ID)
+typedef IdPayload Payload;
+#else
+typedef NoPayload Payload;
+#endif
+
+#ifdef BOTNET_QUEUE_QUATERNARY
+typedef Graph<Cost, Payload, QuaternaryHeap> BotnetGraph;
+#else
+typedef Graph<Cost, Payload, BinaryHeap> BotnetGraph;
+#endif
+
+#endif //GRAPH_H
+#include <ostream>
+
 Place::Place(unsigned int id) {
     this->id = id;
+    this->branch = NULL;
 }
 
 Place::~Place() {
+    delete this->branch;
 }
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
 
-//
-// Edge (Template)
-//
+// Every number from 00 to 99, so that integers can be converted two digits at a time
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
 
-template<class T>
-Edge<T>::Edge(Vertex<T> *const vertex, int cost) {
-    this->vertex = vertex;
-    this->cost = cost;
+Writer::Writer(int descriptor, unsigned int capacity) {
+    this->descriptor = descriptor;
+    this->capacity = capacity;
+    this->buffer = new char[capacity];
+    this->length = 0;
+    this->failed = false;
 }
 
-template<class T>
-Edge<T>::~Edge() {
+void Writer::write(const char *data, unsigned int length) {
+    if (this->length + length > this->capacity) {
+        flush();
+        // Too big to be buffered at all, so skip the copy
+        if (length > this->capacity) {
+            unsigned int written = 0;
+            while (!this->failed && written < length) {
+                ssize_t chunk = ::write(this->descriptor, data + written, length - written);
+                if (chunk == -1 && errno == EINTR) {
+                    continue;
+                }
+                this->failed = chunk <= 0;
+                written += chunk > 0 ? chunk : 0;
+            }
+            return;
+        }
+    }
+    memcpy(this->buffer + this->length, data, length);
+    this->length += length;
 }
 
-//
-// Vertex (Template)
-//
+void Writer::write(char character) {
+    if (this->length == this->capacity) {
+        flush();
+    }
+    this->buffer[this->length++] = character;
+}
 
-template<class T>
-Vertex<T>::Vertex(T element) {
-    this->element = element;
-    this->reset();
+void Writer::writeInteger(int64_t value) {
+    // Fill the digits from the end, working on the magnitude as unsigned so that the minimum value doesn't overflow
+    char digits[20];
+    unsigned int start = sizeof(digits);
+    uint64_t magnitude = value < 0 ? -(uint64_t) value : (uint64_t) value;
+    while (magnitude >= 100) {
+        unsigned int pair = (magnitude % 100) * 2;
+        magnitude /= 100;
+        digits[--start] = DIGIT_PAIRS[pair + 1];
+        digits[--start] = DIGIT_PAIRS[pair];
+    }
+    if (magnitude >= 10) {
+        unsigned int pair = magnitude * 2;
+        digits[--start] = DIGIT_PAIRS[pair + 1];
+        digits[--start] = DIGIT_PAIRS[pair];
+    } else {
+        digits[--start] = '0' + magnitude;
+    }
+
+    if (value < 0) {
+        write('-');
+    }
+    write(digits + start, sizeof(digits) - start);
 }
 
-template<class T>
-void Vertex<T>::addLink(Vertex<T> *const vertex, int cost) {
-    this->edges.push_back(Edge<T>(vertex, cost));
+void Writer::writeBinary(uint32_t value) {
+    write((const char *) &value, sizeof(value));
 }
 
-template<class T>
-inline void Vertex<T>::reset() {
-    this->distance = INFINITE;
+void Writer::writeBinary(int64_t value) {
+    write((const char *) &value, sizeof(value));
 }
 
-template<class T>
-void Vertex<T>::saveDistance() {
-    this->h = this->distance;
+bool Writer::flush() {
+    unsigned int written = 0;
+    while (!this->failed && written < this->length) {
+        ssize_t chunk = ::write(this->descriptor, this->buffer + written, this->length - written);
+        if (chunk == -1 && errno == EINTR) {
+            continue;
+        }
+        this->failed = chunk <= 0;
+        written += chunk > 0 ? chunk : 0;
+    }
+    this->length = 0;
+    return !this->failed;
 }
 
-template<class T>
-inline std::list<Edge<T> > &Vertex<T>::getEdges() {
-    return this->edges;
+Writer::~Writer() {
+    flush();
+    delete[] this->buffer;
 }
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#include <queue>
+#include <unistd.h>
 
-template<class T>
-Vertex<T>::~Vertex() {
-    delete this->element;
+//
+// Vertex (Template)
+//
+
+template<class C, class P>
+Vertex<C, P>::Vertex(unsigned int id) : P(id) {
+    this->h = 0;
 }
 
-struct distance_less {
-    template<class T>
-    bool operator()(const Vertex<T>* left, const Vertex<T>* right) const {
-        return left->distance > right->distance;
-    }
-};
+//
+// Query (Class)
+//
+
+Query::Query() {
+    this->objective = OBJECTIVE_SUM;
+    this->engine = ENGINE_AUTO;
+    this->branchesOnly = false;
+    this->k = 1;
+}
 
 //
-// Graph (Class)
+// Graph (Template)
 //
 
-Graph::Graph() {
+template<class C, class P, template<class> class Q>
+Graph<C, P, Q>::Graph() {
     this->placesLength = 0;
-    this->branchesLength = 0;
+    this->linksLength = 0;
+    this->engine = ENGINE_AUTO;
+    this->format = FORMAT_TEXT;
+    this->reweighted = false;
+    this->maximumCost = 0;
+    this->bucketWidth = 1;
 }
 
-void Graph::populate() {
-    // Parse first line
-    unsigned int linksLength;
-    std::cin >> this->placesLength >> this->branchesLength >> linksLength;
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::populate(std::istream &input) {
+    clear();
 
-    // Save vertex 0 for Johnson's algorithm
+    // Parse first line
+    unsigned int branchesLength;
+    input >> this->placesLength >> branchesLength >> this->linksLength;
+    // places starts at 1 and 0 is saved for the s vertex in johnson's algorithm, so add 1 extra place for s.
     this->placesLength++;
-    this->places = new Vertex<Place *> *[placesLength];
-    this->places[S_INDEX] = NULL;
-    this->branches = new Vertex<Place *> *[branchesLength];
-    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Place *place = new Place(placeIndex);
-        this->places[placeIndex] = new Vertex<Place *>(place);
+    this->places.reserve(this->placesLength);
+    for (unsigned int placeIndex = 0; placeIndex < this->placesLength; placeIndex++) {
+        this->places.push_back(Vertex<C, P>(placeIndex));
     }
 
     // Parse second line
-    for (unsigned int branchIndex = 0; branchIndex < this->branchesLength; branchIndex++) {
-        unsigned int id;
-        std::cin >> id;
-        this->branches[branchIndex] = this->places[id];
+    this->branches.resize(branchesLength);
+    for (unsigned int branchIndex = 0; branchIndex < branchesLength; branchIndex++) {
+        input >> this->branches[branchIndex];
+        this->places[this->branches[branchIndex]].setBranch();
     }
 
     // Parse connections
-    for (unsigned int connection = 0; connection < linksLength; connection++) {
-        unsigned int from, to;
-        int cost;
-        std::cin >> from >> to >> cost;
-        this->places[from]->addLink(this->places[to], cost);
+    std::vector<unsigned int> origins(this->linksLength);
+    std::vector<Edge<C> > links(this->linksLength);
+    for (unsigned int connection = 0; connection < this->linksLength; connection++) {
+        input >> origins[connection] >> links[connection].vertex >> links[connection].cost;
     }
+
+    // Pack the edges by origin, and by destination for the backward ones.
+    // Count the edges of each vertex first, so each of them knows where its edges start.
+    this->forward.starts.assign(this->placesLength + 1, 0);
+    this->backward.starts.assign(this->placesLength + 1, 0);
+    for (unsigned int connection = 0; connection < this->linksLength; connection++) {
+        this->forward.starts[origins[connection] + 1]++;
+        this->backward.starts[links[connection].vertex + 1]++;
+    }
+    for (unsigned int placeIndex = 0; placeIndex < this->placesLength; placeIndex++) {
+        this->forward.starts[placeIndex + 1] += this->forward.starts[placeIndex];
+        this->backward.starts[placeIndex + 1] += this->backward.starts[placeIndex];
+    }
+    this->forward.edges.resize(this->linksLength);
+    this->backward.edges.resize(this->linksLength);
+    std::vector<unsigned int> forwardEnds(this->forward.starts.begin(), this->forward.starts.end() - 1);
+    std::vector<unsigned int> backwardEnds(this->backward.starts.begin(), this->backward.starts.end() - 1);
+    for (unsigned int connection = 0; connection < this->linksLength; connection++) {
+        unsigned int from = origins[connection];
+        unsigned int to = links[connection].vertex;
+        this->forward.edges[forwardEnds[from]++] = links[connection];
+        Edge<C> &backwardEdge = this->backward.edges[backwardEnds[to]++];
+        backwardEdge.vertex = from;
+        backwardEdge.cost = links[connection].cost;
+    }
+}
+
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::setEngine(Engine engine) {
+    this->engine = engine;
+}
+
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::setFormat(Format format) {
+    this->format = format;
+}
+
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::execute(const Query &query) {
+    johnson(query);
+}
+
+template<class C, class P, template<class> class Q>
+std::vector<unsigned int> Graph<C, P, Q>::getBranches() const {
+    return this->branches;
 }
 
-void Graph::execute() {
-    // Create the S vertex.
-    this->places[S_INDEX] = new Vertex<Place *>(NULL);
-    // Add a edge from S to every vertex with cost 0.
+template<class C, class P, template<class> class Q>
+unsigned int Graph<C, P, Q>::getPlacesLength() const {
+    return this->placesLength - PLACES_START_INDEX;
+}
+
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::print() const {
+    std::cout << "Places: " << this->placesLength - 1 << ", Branches: " << this->branches.size() << std::endl;
     for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        this->places[S_INDEX]->addLink(places[placeIndex], 0);
+        std::cout << "Place " << placeIndex;
+        this->places[placeIndex].describe(std::cout);
+        std::cout << " is linked to: " << std::endl;
+        for (unsigned int edgeIndex = this->forward.starts[placeIndex]; edgeIndex < this->forward.starts[placeIndex + 1]; edgeIndex++) {
+            const Edge<C> &edge = this->forward.edges[edgeIndex];
+            std::cout << "\t-> Place " << edge.vertex << " with cost " << edge.cost;
+            this->places[edge.vertex].describe(std::cout);
+            std::cout << std::endl;
+        }
     }
-    // Run the Bellman-Ford algorithm starting from S.
-    bellmanFord(this->places[S_INDEX]);
+}
 
-    // Save the distances calculated in vertices' h field
-    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *vertex = places[placeIndex];
-        vertex->saveDistance();
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::bellmanFord() {
+    // s reaches every place with cost 0 in one step, so start from there
+    for (unsigned int placeIndex = 0; placeIndex < this->placesLength; placeIndex++) {
+        this->places[placeIndex].h = 0;
     }
 
-    // Re-weight the edges.
+    // Relax edges
+    for (unsigned int iteration = 0; iteration < this->placesLength; iteration++) {
+        // Use this flag to check whether anything changed on the iteration
+        // If nothing changed, no need to continue as nothing will change in the next step
+        bool done = true;
+
+        // For each edge, relax if possible
+        for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
+            C origin = this->places[placeIndex].h;
+            for (unsigned int edgeIndex = this->forward.starts[placeIndex]; edgeIndex < this->forward.starts[placeIndex + 1]; edgeIndex++) {
+                const Edge<C> &edge = this->forward.edges[edgeIndex];
+                // Overflow is possible for enormous (near the maximum of C) weights
+                if (origin + edge.cost < this->places[edge.vertex].h) {
+                    this->places[edge.vertex].h = origin + edge.cost;
+                    done = false;
+                }
+            }
+        }
+
+        if (done) {
+            break;
+        }
+    }
+}
+
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::condense() {
+    const unsigned int unvisited = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> &components = this->condensation.components;
+    components.assign(this->placesLength, 0);
+    this->condensation.componentsLength = 0;
+
+    // Tarjan's algorithm, with an explicit stack of (place, next edge) frames instead of recursion,
+    // as a long path would overflow the call stack.
+    std::vector<unsigned int> indexes(this->placesLength, unvisited);
+    std::vector<unsigned int> lowLinks(this->placesLength);
+    std::vector<char> stacked(this->placesLength, false);
+    std::vector<unsigned int> stack;
+    std::vector<std::pair<unsigned int, unsigned int> > frames;
+    unsigned int counter = 0;
+    for (unsigned int rootIndex = PLACES_START_INDEX; rootIndex < this->placesLength; rootIndex++) {
+        if (indexes[rootIndex] != unvisited) {
+            continue;
+        }
+        indexes[rootIndex] = lowLinks[rootIndex] = counter++;
+        stack.push_back(rootIndex);
+        stacked[rootIndex] = true;
+        frames.push_back(std::make_pair(rootIndex, this->forward.starts[rootIndex]));
+
+        while (!frames.empty()) {
+            unsigned int placeIndex = frames.back().first;
+            unsigned int edgeIndex = frames.back().second;
+            if (edgeIndex < this->forward.starts[placeIndex + 1]) {
+                // Follow the next edge, descending into the place at its end if it's new
+                frames.back().second++;
+                unsigned int nextIndex = this->forward.edges[edgeIndex].vertex;
+                if (indexes[nextIndex] == unvisited) {
+                    indexes[nextIndex] = lowLinks[nextIndex] = counter++;
+                    stack.push_back(nextIndex);
+                    stacked[nextIndex] = true;
+                    frames.push_back(std::make_pair(nextIndex, this->forward.starts[nextIndex]));
+                } else if (stacked[nextIndex]) {
+                    lowLinks[placeIndex] = std::min(lowLinks[placeIndex], indexes[nextIndex]);
+                }
+                continue;
+            }
+
+            // Every edge is done, so the place is the root of a component if nothing below it reached further up
+            if (lowLinks[placeIndex] == indexes[placeIndex]) {
+                unsigned int memberIndex;
+                do {
+                    memberIndex = stack.back();
+                    stack.pop_back();
+                    stacked[memberIndex] = false;
+                    components[memberIndex] = this->condensation.componentsLength;
+                } while (memberIndex != placeIndex);
+                this->condensation.componentsLength++;
+            }
+            frames.pop_back();
+            if (!frames.empty()) {
+                unsigned int parentIndex = frames.back().first;
+                lowLinks[parentIndex] = std::min(lowLinks[parentIndex], lowLinks[placeIndex]);
+            }
+        }
+    }
+
+    // Pack the edges between components like the place edges, counting them first
+    std::vector<unsigned int> &starts = this->condensation.starts;
+    starts.assign(this->condensation.componentsLength + 1, 0);
+    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
+        for (unsigned int edgeIndex = this->forward.starts[placeIndex]; edgeIndex < this->forward.starts[placeIndex + 1]; edgeIndex++) {
+            if (components[placeIndex] != components[this->forward.edges[edgeIndex].vertex]) {
+                starts[components[placeIndex] + 1]++;
+            }
+        }
+    }
+    for (unsigned int component = 0; component < this->condensation.componentsLength; component++) {
+        starts[component + 1] += starts[component];
+    }
+    this->condensation.successors.resize(starts[this->condensation.componentsLength]);
+    std::vector<unsigned int> ends(starts.begin(), starts.end() - 1);
     for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *origin = places[placeIndex];
-        std::list<Edge<Place *> > &edges = origin->getEdges();
-        for (std::list<Edge<Place *> >::iterator it = edges.begin(); it != edges.end(); it++) {
-            Edge<Place *> &edge = *it;
-            Vertex<Place *> *destination = edge.vertex;
-            edge.cost = edge.cost + origin->h - destination->h;
+        for (unsigned int edgeIndex = this->forward.starts[placeIndex]; edgeIndex < this->forward.starts[placeIndex + 1]; edgeIndex++) {
+            unsigned int successor = components[this->forward.edges[edgeIndex].vertex];
+            if (components[placeIndex] != successor) {
+                this->condensation.successors[ends[components[placeIndex]]++] = successor;
+            }
         }
     }
+}
 
-    // Delete S as it's no longer needed.
-    delete this->places[S_INDEX];
-    this->places[S_INDEX] = NULL;
+template<class C, class P, template<class> class Q>
+bool Graph<C, P, Q>::prune(const std::vector<unsigned int> &sources, const std::vector<unsigned int> &candidates, bool everyPlace, std::vector<char, GRAPH_ALLOCATOR<char> > &allowed) const {
+    const Condensation &condensation = this->condensation;
+    unsigned int componentsLength = condensation.componentsLength;
 
-    // Array that will contain the total losses per place
-    int totalLoss[placesLength];
-    std::fill(totalLoss, totalLoss + placesLength, 0);
+    // Branches in the same component reach the same places, so only their components matter
+    std::vector<unsigned int> sourceComponents(sources.size());
+    for (unsigned int sourceIndex = 0; sourceIndex < sources.size(); sourceIndex++) {
+        sourceComponents[sourceIndex] = condensation.components[sources[sourceIndex]];
+    }
+    std::sort(sourceComponents.begin(), sourceComponents.end());
+    sourceComponents.erase(std::unique(sourceComponents.begin(), sourceComponents.end()), sourceComponents.end());
 
-    // Run Dijkstra and calculate total loss to every place, from each branch.
-    for (unsigned int branchIndex = 0; branchIndex < branchesLength; branchIndex++) {
-        Vertex<Place *> *source = branches[branchIndex];
-        dijkstra(source);
-        for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < placesLength; placeIndex++) {
-            Vertex<Place *> *destination = places[placeIndex];
-
-            // If distance is infinite then distance will remain infinite since we can't reach the destination from source.
-            // Only reason we do this rather than just sum infinite with infinite is to prevent integer overflows.
-            if (destination->distance == INFINITE) {
-                totalLoss[placeIndex] = INFINITE;
-            } else if (totalLoss[placeIndex] != INFINITE) {
-                totalLoss[placeIndex] += destination->distance + destination->h - source->h;
+    // A component is reachable by everyone if each group of 64 sources reaches it with all of its bits.
+    // Going down the component numbers is a topological order, so each component has all of its bits before passing them on.
+    std::vector<char> reachable(componentsLength, true);
+    std::vector<uint64_t> reached(componentsLength);
+    for (unsigned int groupStart = 0; groupStart < sourceComponents.size(); groupStart += 64) {
+        unsigned int groupLength = std::min(64u, (unsigned int) sourceComponents.size() - groupStart);
+        uint64_t everyone = groupLength == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << groupLength) - 1;
+        std::fill(reached.begin(), reached.end(), 0);
+        for (unsigned int bit = 0; bit < groupLength; bit++) {
+            reached[sourceComponents[groupStart + bit]] |= (uint64_t) 1 << bit;
+        }
+        for (unsigned int component = componentsLength; component-- > 0;) {
+            if (reached[component] == 0) {
+                continue;
             }
+            for (unsigned int successorIndex = condensation.starts[component]; successorIndex < condensation.starts[component + 1]; successorIndex++) {
+                reached[condensation.successors[successorIndex]] |= reached[component];
+            }
+        }
+        for (unsigned int component = 0; component < componentsLength; component++) {
+            reachable[component] = reachable[component] && reached[component] == everyone;
         }
     }
 
-    // Find the encounter place based on total loss.
-    int minimumTotalLoss = INFINITE;
-    int encounterPlaceIndex = -1;
-    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < placesLength; placeIndex++) {
-        if (totalLoss[placeIndex] < minimumTotalLoss) {
-            minimumTotalLoss = totalLoss[placeIndex];
-            encounterPlaceIndex = placeIndex;
+    // Mark the components holding a valid meeting point
+    std::vector<char> relevant(componentsLength, false);
+    bool found = false;
+    unsigned int candidatesLength = everyPlace ? this->placesLength - PLACES_START_INDEX : candidates.size();
+    for (unsigned int candidateIndex = 0; candidateIndex < candidatesLength; candidateIndex++) {
+        unsigned int component = condensation.components[everyPlace ? PLACES_START_INDEX + candidateIndex : candidates[candidateIndex]];
+        if (reachable[component]) {
+            relevant[component] = true;
+            found = true;
         }
     }
+    if (!found) {
+        return false;
+    }
 
-    // Print the output based on the encounter point.
-    if (encounterPlaceIndex == -1) {
-        std::cout << "N" << std::endl;
-    } else {
-        Vertex<Place *> *encounterPlace = places[encounterPlaceIndex];
-
-        // Rather than calculating each distance again, it's easier to transpose the graph.
-        // After that's done, simply calculate the distance from the encounter point to each branch.
-        // This is more efficient if two or more branches exist
-        transpose();
-        dijkstra(encounterPlace);
-
-        std::cout << encounterPlace->element->id << " " << minimumTotalLoss << std::endl;
-        for (unsigned int branchIndex = 0; branchIndex < branchesLength; branchIndex++) {
-            Vertex<Place *> *branch = branches[branchIndex];
-            std::cout << branch->distance + encounterPlace->h - branch->h << " ";
+    // Then every component leading to one of them, going up the component numbers so successors are done first
+    for (unsigned int component = 0; component < componentsLength; component++) {
+        for (unsigned int successorIndex = condensation.starts[component]; successorIndex < condensation.starts[component + 1] && !relevant[component]; successorIndex++) {
+            relevant[component] = relevant[condensation.successors[successorIndex]];
         }
-        std::cout << std::endl;
     }
-}
 
-void Graph::print() const {
-    std::cout << "Places: " << this->placesLength - 1 << ", Branches: " << this->branchesLength << std::endl;
+    allowed.assign(this->placesLength, false);
     for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *vertex = this->places[placeIndex];
-        std::cout << "Place " << vertex->element->id << "[" << vertex << "]" << " is linked to: " << std::endl;
-        std::list<Edge<Place *> > &links = vertex->getEdges();
-        for (std::list<Edge<Place *> >::iterator it = links.begin(); it != links.end(); it++) {
-            Edge<Place *> &edge = *it;
-            Vertex<Place *> *linked = edge.vertex;
-            std::cout << "\t-> Place " << linked->element->id << "[" << linked << "] with cost " << edge.cost << std::endl;
-        }
+        allowed[placeIndex] = relevant[condensation.components[placeIndex]];
     }
+    return true;
 }
 
-bool Graph::bellmanFord(Vertex<Place *> *source) {
-    // Initialize the graph
-    for (unsigned int placeIndex = 0; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *vertex = places[placeIndex];
-        if (vertex != NULL)
-            vertex->reset();
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::batchedDijkstra(const unsigned int *sources, unsigned int sourcesLength, bool reversed, const char *allowed, C *distances) const {
+    const C infinite = std::numeric_limits<C>::max();
+    const Adjacency<C> &adjacency = reversed ? this->backward : this->forward;
+
+    // Initialize every lane of every place, including the lanes no source will use
+    std::fill(distances, distances + this->placesLength * BATCH_WIDTH, infinite);
+
+    // Lanes of each place that changed since it was last expanded, one bit per lane
+    std::vector<LaneMask, GRAPH_ALLOCATOR<LaneMask> > pending(this->placesLength, 0);
+
+    // Smallest distance among the pending lanes of each place, which decides the bucket it's in.
+    // Bucket entries whose key has moved to another bucket are stale and get skipped.
+    std::vector<C, GRAPH_ALLOCATOR<C> > keys(this->placesLength, infinite);
+
+    // Expanding a place relaxes its pending lanes up to reach buckets past the current one, the rest wait for later.
+    // Pending distances then never go past twice that, so buckets can be reused circularly.
+    // The queue holds the number of each bucket that went from empty to holding places, smallest on top.
+    const C bucketWidth = this->bucketWidth;
+    const C reach = this->maximumCost / bucketWidth;
+    std::vector<std::vector<unsigned int> > buckets(reach * 2 + 2);
+    Q<C> queue;
+
+    // Insert every source, each with distance 0 in its own lane
+    for (unsigned int lane = 0; lane < sourcesLength; lane++) {
+        unsigned int sourceIndex = sources[lane];
+        distances[sourceIndex * BATCH_WIDTH + lane] = 0;
+        pending[sourceIndex] |= (LaneMask) 1 << lane;
+        if (keys[sourceIndex] != 0) {
+            keys[sourceIndex] = 0;
+            buckets[0].push_back(sourceIndex);
+        }
+    }
+    if (sourcesLength > 0) {
+        queue.push(0);
     }
-    source->distance = 0;
 
-    // Relax edges
-    for (unsigned int iteration = 0; iteration < this->placesLength; iteration++) {
-        // Use this flag to check whether anything changed on the iteration
-        // If nothing changed, no need to continue as nothing will change in the next step
-        bool done = true;
+    // Run the label-correcting main loop, a bucket at a time. Expanding a place relaxes all of its pending lanes at once,
+    // so a single walk through its edges serves every source. Places expanded in the same bucket can be expanded
+    // again when one of their lanes improves, so every lane still ends with its exact distance.
+    while (!queue.empty()) {
+        C bucketIndex = queue.top();
+        queue.pop();
+        std::vector<unsigned int> &bucket = buckets[bucketIndex % buckets.size()];
 
-        // For each edge, relax if possible
-        for (unsigned int placeIndex = 0; placeIndex < this->placesLength; placeIndex++) {
-            Vertex<Place *> *origin = places[placeIndex];
-            if (origin != NULL) {
-                std::list<Edge<Place *> > &edges = origin->getEdges();
-                for (std::list<Edge<Place *> >::iterator it = edges.begin(); it != edges.end(); it++) {
-                    Edge<Place *> &edge = *it;
-                    Vertex<Place *> *destination = edge.vertex;
-                    // Relax whenever possible
-                    // Overflow is possible for enormous (near 2^31) weights
-                    if (origin->distance != INFINITE && origin->distance + edge.cost < destination->distance) {
-                        done = false;
-                        destination->distance = origin->distance + edge.cost;
+        // Expanding places can put more places in the same bucket, so keep going until it stays empty
+        while (!bucket.empty()) {
+            std::vector<unsigned int> taken;
+            taken.swap(bucket);
+            for (unsigned int entry = 0; entry < taken.size(); entry++) {
+                unsigned int currentIndex = taken[entry];
+                if (keys[currentIndex] == infinite || keys[currentIndex] / bucketWidth != bucketIndex) {
+                    continue;
+                }
+                const C *current = distances + currentIndex * BATCH_WIDTH;
+
+                // Split the pending lanes into the ones expanded now and the ones left for a later bucket
+                LaneMask expanded = 0;
+                C rest = infinite;
+                for (unsigned int lane = 0; lane < BATCH_WIDTH; lane++) {
+                    if (pending[currentIndex] & ((LaneMask) 1 << lane)) {
+                        if (current[lane] / bucketWidth <= bucketIndex + reach) {
+                            expanded |= (LaneMask) 1 << lane;
+                        } else {
+                            rest = std::min(rest, current[lane]);
+                        }
                     }
                 }
-            }
+                pending[currentIndex] &= ~expanded;
+                keys[currentIndex] = rest;
+                if (rest != infinite) {
+                    std::vector<unsigned int> &restBucket = buckets[(rest / bucketWidth) % buckets.size()];
+                    if (restBucket.empty()) {
+                        queue.push(rest / bucketWidth);
+                    }
+                    restBucket.push_back(currentIndex);
+                }
 
-            if (done){
-                break;
+                // Iterate through every neighbour
+                for (unsigned int edgeIndex = adjacency.starts[currentIndex]; edgeIndex < adjacency.starts[currentIndex + 1]; edgeIndex++) {
+                    const Edge<C> &edge = adjacency.edges[edgeIndex];
+                    if (!allowed[edge.vertex]) {
+                        continue;
+                    }
+                    C *destination = distances + edge.vertex * BATCH_WIDTH;
+
+                    // Relax the expanded lanes, remembering the smallest distance that improved
+                    C improved = infinite;
+                    LaneMask changed = 0;
+                    for (unsigned int lane = 0; lane < BATCH_WIDTH; lane++) {
+                        if ((expanded & ((LaneMask) 1 << lane)) && current[lane] + edge.cost < destination[lane]) {
+                            destination[lane] = current[lane] + edge.cost;
+                            changed |= (LaneMask) 1 << lane;
+                            improved = std::min(improved, destination[lane]);
+                        }
+                    }
+                    pending[edge.vertex] |= changed;
+
+                    // Move the place to an earlier bucket if it needs one, a lower key in the same bucket needs nothing
+                    if (improved < keys[edge.vertex]) {
+                        bool moved = keys[edge.vertex] == infinite || keys[edge.vertex] / bucketWidth != improved / bucketWidth;
+                        keys[edge.vertex] = improved;
+                        if (moved) {
+                            std::vector<unsigned int> &destinationBucket = buckets[(improved / bucketWidth) % buckets.size()];
+                            if (destinationBucket.empty() && improved / bucketWidth != bucketIndex) {
+                                queue.push(improved / bucketWidth);
+                            }
+                            destinationBucket.push_back(edge.vertex);
+                        }
+                    }
+                }
             }
         }
     }
+}
 
-    return true;
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::search(const unsigned int *sources, unsigned int sourcesLength, bool reversed, const char *allowed, DeltaStepping<C> *deltaStepping, C *distances) const {
+    batchedDijkstra(sources, sourcesLength, reversed, allowed, distances);
 }
 
-void Graph::dijkstra(Vertex<Place *> *source) {
-    // Initialize the graph
+template<class C, class P, template<class> class Q>
+Engine Graph<C, P, Q>::chooseEngine(unsigned int sourcesLength, unsigned int threadsLength) const {
+    return ENGINE_DIJKSTRA;
+}
+
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::prepare() {
+    // Runs bellman-ford from s and re-weights every edge so that none is negative.
+    // Only does so the first time it's called.
+    if (this->reweighted) {
+        return;
+    }
+    this->reweighted = true;
+
+    // Save the distances from s in each vertex's h field.
+    bellmanFord();
+
+    // Find the components, so queries can tell early which places are worth searching.
+    condense();
+
+    // Re-weight the edges, and their backward copies.
     for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *vertex = places[placeIndex];
-        vertex->reset();
+        C h = this->places[placeIndex].h;
+        for (unsigned int edgeIndex = this->forward.starts[placeIndex]; edgeIndex < this->forward.starts[placeIndex + 1]; edgeIndex++) {
+            Edge<C> &edge = this->forward.edges[edgeIndex];
+            edge.cost = edge.cost + h - this->places[edge.vertex].h;
+        }
+        for (unsigned int edgeIndex = this->backward.starts[placeIndex]; edgeIndex < this->backward.starts[placeIndex + 1]; edgeIndex++) {
+            Edge<C> &edge = this->backward.edges[edgeIndex];
+            edge.cost = edge.cost + this->places[edge.vertex].h - h;
+        }
     }
 
-    // Create the priority queue (reversed)
-    std::priority_queue<Vertex<Place*>*, std::vector<Vertex<Place*>*>, distance_less> queue;
+    // Buckets of the batched dijkstra span the most expensive edge over the average degree, like delta-stepping's,
+    // divided again by the number of lanes, as a batch expands that many times more places per bucket.
+    this->maximumCost = 0;
+    for (unsigned int edgeIndex = 0; edgeIndex < this->forward.edges.size(); edgeIndex++) {
+        this->maximumCost = std::max(this->maximumCost, this->forward.edges[edgeIndex].cost);
+    }
+    unsigned int averageDegree = std::max(1u, this->linksLength / std::max(1u, this->placesLength - PLACES_START_INDEX));
+    this->bucketWidth = std::max((C) 1, this->maximumCost / (C) averageDegree / (C) BATCH_WIDTH);
+}
 
-    // Insert the source into the queue, with distance 0
-    source->distance = 0;
-    queue.push(source);
+template<class C, class P, template<class> class Q>
+std::vector<Selection<C> > Graph<C, P, Q>::select(const Query &query, unsigned int threadsLength) const {
+    const C infinite = std::numeric_limits<C>::max();
 
-    // Run dijkstra main loop
-    while (!queue.empty()){
-        // Get top element from the priority queue
-        Vertex<Place *> *current = queue.top();
-        queue.pop();
+    // Find the branches meeting
+    const std::vector<unsigned int> &sources = query.branches.empty() ? this->branches : query.branches;
+    unsigned int sourcesLength = sources.size();
+
+    // Find the places allowed as meeting points
+    const std::vector<unsigned int> &candidates = query.branchesOnly ? sources : query.candidates;
+    bool everyPlace = candidates.empty() && !query.branchesOnly;
+
+    // Narrow the searches down to the places that lead to a valid meeting point, and stop right away if there are none
+    std::vector<char, GRAPH_ALLOCATOR<char> > allowed;
+    if (query.k == 0 || !prune(sources, candidates, everyPlace, allowed)) {
+        return std::vector<Selection<C> >();
+    }
+
+    // Branches are processed BATCH_WIDTH at a time, so each pass through the edges is shared by the whole batch.
+    // With few branches on a big graph, each branch gets all cores through delta-stepping instead.
+    // The query's engine comes first, then the graph's, and the choice is only made here if neither picked one.
+    Engine engine = query.engine != ENGINE_AUTO ? query.engine : this->engine;
+    if (engine == ENGINE_AUTO) {
+        engine = chooseEngine(sourcesLength, threadsLength > 0 ? threadsLength : sysconf(_SC_NPROCESSORS_ONLN));
+    }
+    DeltaStepping<C> *deltaStepping = NULL;
+    unsigned int batchWidth = BATCH_WIDTH;
+    std::vector<C, GRAPH_ALLOCATOR<C> > distances(this->placesLength * BATCH_WIDTH);
+
+    // Array that will contain the total losses per place.
+    // Minimax starts as low as possible, so that the first branch's loss always replaces it.
+    C initialLoss = query.objective == OBJECTIVE_MINIMAX && sourcesLength > 0 ? std::numeric_limits<C>::min() : 0;
+    std::vector<C, GRAPH_ALLOCATOR<C> > totalLoss(this->placesLength, initialLoss);
+
+    // Run Dijkstra and calculate total loss to every place, from each branch.
+    for (unsigned int batchStart = 0; batchStart < sourcesLength; batchStart += batchWidth) {
+        unsigned int batchLength = std::min(batchWidth, sourcesLength - batchStart);
+        search(&sources[batchStart], batchLength, false, &allowed[0], deltaStepping, &distances[0]);
+        for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
+            const C *destinationDistances = &distances[placeIndex * batchWidth];
+
+            for (unsigned int lane = 0; lane < batchLength; lane++) {
+                // If distance is infinite then distance will remain infinite since we can't reach the destination from source.
+                // Only reason we do this rather than just sum infinite with infinite is to prevent integer overflows.
+                if (destinationDistances[lane] == infinite) {
+                    totalLoss[placeIndex] = infinite;
+                } else if (totalLoss[placeIndex] != infinite) {
+                    unsigned int branchIndex = batchStart + lane;
+                    C loss = destinationDistances[lane] + this->places[placeIndex].h - this->places[sources[branchIndex]].h;
+                    if (query.objective == OBJECTIVE_MINIMAX) {
+                        totalLoss[placeIndex] = std::max(totalLoss[placeIndex], loss);
+                    } else if (query.objective == OBJECTIVE_WEIGHTED_SUM && branchIndex < query.weights.size()) {
+                        totalLoss[placeIndex] += query.weights[branchIndex] * loss;
+                    } else {
+                        totalLoss[placeIndex] += loss;
+                    }
+                }
+            }
+        }
+    }
+
+    // Keep the k best places in a heap, with the worst of them on top.
+    // Ties go to the lowest place id, like a plain scan for the minimum would.
+    typedef std::pair<C, unsigned int> Candidate;
+    std::priority_queue<Candidate> best;
+    std::vector<bool> seen(this->placesLength, false);
+    unsigned int candidatesLength = everyPlace ? this->placesLength - PLACES_START_INDEX : candidates.size();
+    for (unsigned int candidateIndex = 0; candidateIndex < candidatesLength; candidateIndex++) {
+        unsigned int placeIndex = everyPlace ? PLACES_START_INDEX + candidateIndex : candidates[candidateIndex];
+        if (totalLoss[placeIndex] == infinite || seen[placeIndex]) {
+            continue;
+        }
+        seen[placeIndex] = true;
 
-        // Iterate through every neighbour
-        std::list<Edge<Place *> > &edges = current->getEdges();
-        for (std::list<Edge<Place *> >::iterator it = edges.begin(); it != edges.end(); it++) {
-            Edge<Place *> &edge = *it;
-            Vertex<Place *> *destination = edge.vertex;
+        Candidate candidate(totalLoss[placeIndex], placeIndex);
+        if (best.size() < query.k) {
+            best.push(candidate);
+        } else if (candidate < best.top()) {
+            best.pop();
+            best.push(candidate);
+        }
+    }
+
+    // Empty the heap, best place first
+    std::vector<Selection<C> > selections(best.size());
+    std::vector<unsigned int> selected(best.size());
+    for (unsigned int selectionIndex = selections.size(); selectionIndex-- > 0; best.pop()) {
+        selections[selectionIndex].id = best.top().second;
+        selections[selectionIndex].loss = best.top().first;
+        selections[selectionIndex].distances.resize(sourcesLength);
+        selected[selectionIndex] = best.top().second;
+    }
 
-            // If this newly discovered distance is shorter than the previous ones
-            if (current->distance + edge.cost < destination->distance) {
-                destination->distance = current->distance + edge.cost;
-                queue.push(destination);
+    // Search backwards from the selected places, which gives the distance from each branch to them without
+    // touching the graph, in as many passes as it takes to cover the selected places rather than the branches.
+    for (unsigned int batchStart = 0; batchStart < selected.size(); batchStart += batchWidth) {
+        unsigned int batchLength = std::min(batchWidth, (unsigned int) selected.size() - batchStart);
+        search(&selected[batchStart], batchLength, true, &allowed[0], deltaStepping, &distances[0]);
+        for (unsigned int lane = 0; lane < batchLength; lane++) {
+            C placeH = this->places[selected[batchStart + lane]].h;
+            for (unsigned int branchIndex = 0; branchIndex < sourcesLength; branchIndex++) {
+                unsigned int branch = sources[branchIndex];
+                selections[batchStart + lane].distances[branchIndex] = distances[branch * batchWidth + lane] + placeH - this->places[branch].h;
             }
         }
     }
 
+    return selections;
+}
+
+
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::johnson(const Query &query) {
+    // Re-weight the graph so that Dijkstra can run on it.
+    prepare();
 
+    // Find the encounter places based on total loss, and print them.
+    Writer writer(STDOUT_FILENO);
+    printSelections(writer, select(query), this->format);
 }
 
-void Graph::transpose() {
-    // Store the number of edges for each vertex
-    // Store it under its distance since it was ruined anyway
-    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *vertex = places[placeIndex];
-        std::list<Edge<Place *> > &edges = vertex->getEdges();
-        vertex->distance = edges.size();
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::printSelections(Writer &writer, const std::vector<Selection<C> > &selections, Format format) const {
+    if (format == FORMAT_BINARY) {
+        writer.writeBinary((uint32_t) selections.size());
+        for (unsigned int selectionIndex = 0; selectionIndex < selections.size(); selectionIndex++) {
+            const Selection<C> &selection = selections[selectionIndex];
+            writer.writeBinary((uint32_t) selection.id);
+            writer.writeBinary((int64_t) selection.loss);
+            writer.writeBinary((uint32_t) selection.distances.size());
+            for (unsigned int branchIndex = 0; branchIndex < selection.distances.size(); branchIndex++) {
+                writer.writeBinary((int64_t) selection.distances[branchIndex]);
+            }
+        }
+        return;
     }
 
-    // Iterate each vertex
-    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
-        Vertex<Place *> *origin = places[placeIndex];
-        std::list<Edge<Place *> > &edges = origin->getEdges();
-
-        // Since we know how many edges it has, we can avoid running this twice for the same edge
-        while (origin->distance != 0) {
-            // Get the edge and create its tranposition
-            Edge<Place *> &edge = edges.front();
-            Vertex<Place *> *destination = edge.vertex;
-            destination->addLink(origin, edge.cost);
-
-            // Destroy the edge and decrease the counter
-            edges.pop_front();
-            origin->distance--;
+    if (selections.empty()) {
+        writer.write("N\n", 2);
+    }
+    for (unsigned int selectionIndex = 0; selectionIndex < selections.size(); selectionIndex++) {
+        const Selection<C> &selection = selections[selectionIndex];
+        writer.writeInteger(selection.id);
+        writer.write(' ');
+        writer.writeInteger(selection.loss);
+        writer.write('\n');
+        for (unsigned int branchIndex = 0; branchIndex < selection.distances.size(); branchIndex++) {
+            writer.writeInteger(selection.distances[branchIndex]);
+            writer.write(' ');
         }
+        writer.write('\n');
     }
 }
 
-Graph::~Graph() {
-    delete[] this->branches;
-    for (unsigned int i = 0; i < this->placesLength; ++i) {
-        delete this->places[i];
+template<class C, class P, template<class> class Q>
+void Graph<C, P, Q>::clear() {
+    for (unsigned int placeIndex = 0; placeIndex < this->places.size(); placeIndex++) {
+        this->places[placeIndex].release();
     }
-    delete[] this->places;
+    this->places.clear();
+    this->reweighted = false;
+}
+
+template<class C, class P, template<class> class Q>
+Graph<C, P, Q>::~Graph() {
+    clear();
 }
 
+// The cost type and payload are picked by the build, both queue policies get compiled
+template class Graph<Cost, Payload, BinaryHeap>;
+template class Graph<Cost, Payload, QuaternaryHeap>;
+
+//
+// Entry point of the mooshak build, which only reads the project's input from stdin and prints its output.
+// Options, the server and the verifier are left out.
+//
+
 int main() {
-    Graph *graph = new Graph();
+    BotnetGraph *graph = new BotnetGraph();
     graph->populate();
     graph->execute();
     delete graph;
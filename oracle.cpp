@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <utility>
+#include "oracle.hpp"
+
+template<class C>
+Oracle<C>::Oracle() {
+    this->placesLength = 0;
+}
+
+template<class C>
+void Oracle<C>::populate(std::istream &input) {
+    const C infinite = std::numeric_limits<C>::max();
+
+    // Same input as Graph::populate, with place 0 left unused so that place ids are indexes.
+    unsigned int branchesLength, linksLength;
+    input >> this->placesLength >> branchesLength >> linksLength;
+    this->placesLength++;
+    this->branches.resize(branchesLength);
+    for (unsigned int branchIndex = 0; branchIndex < branchesLength; branchIndex++) {
+        input >> this->branches[branchIndex];
+    }
+
+    // Start with the direct edges only, keeping the cheapest one between each pair of places
+    this->distances.assign(this->placesLength * this->placesLength, infinite);
+    for (unsigned int placeIndex = 0; placeIndex < this->placesLength; placeIndex++) {
+        this->distances[placeIndex * this->placesLength + placeIndex] = 0;
+    }
+    for (unsigned int connection = 0; connection < linksLength; connection++) {
+        unsigned int from, to;
+        C cost;
+        input >> from >> to >> cost;
+        C &distance = this->distances[from * this->placesLength + to];
+        distance = std::min(distance, cost);
+    }
+
+    floydWarshall();
+}
+
+template<class C>
+void Oracle<C>::floydWarshall() {
+    const C infinite = std::numeric_limits<C>::max();
+    unsigned int length = this->placesLength;
+    for (unsigned int middle = PLACES_START_INDEX; middle < length; middle++) {
+        for (unsigned int from = PLACES_START_INDEX; from < length; from++) {
+            C first = this->distances[from * length + middle];
+            if (first == infinite) {
+                continue;
+            }
+            for (unsigned int to = PLACES_START_INDEX; to < length; to++) {
+                C second = this->distances[middle * length + to];
+                if (second != infinite && first + second < this->distances[from * length + to]) {
+                    this->distances[from * length + to] = first + second;
+                }
+            }
+        }
+    }
+}
+
+template<class C>
+std::vector<Selection<C> > Oracle<C>::select(const Query &query) const {
+    const C infinite = std::numeric_limits<C>::max();
+    const std::vector<unsigned int> &sources = query.branches.empty() ? this->branches : query.branches;
+
+    // Every place allowed as a meeting point, once each
+    std::vector<unsigned int> candidates = query.branchesOnly ? sources : query.candidates;
+    if (candidates.empty() && !query.branchesOnly) {
+        for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < this->placesLength; placeIndex++) {
+            candidates.push_back(placeIndex);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // Work out the objective of every candidate every branch can reach, then sort them by it
+    std::vector<std::pair<C, unsigned int> > ranking;
+    for (unsigned int candidateIndex = 0; candidateIndex < candidates.size(); candidateIndex++) {
+        unsigned int place = candidates[candidateIndex];
+        bool reachable = true;
+        C loss = 0;
+        for (unsigned int branchIndex = 0; branchIndex < sources.size(); branchIndex++) {
+            C distance = this->distances[sources[branchIndex] * this->placesLength + place];
+            if (distance == infinite) {
+                reachable = false;
+                break;
+            }
+            if (query.objective == OBJECTIVE_MINIMAX) {
+                loss = branchIndex == 0 ? distance : std::max(loss, distance);
+            } else if (query.objective == OBJECTIVE_WEIGHTED_SUM && branchIndex < query.weights.size()) {
+                loss += query.weights[branchIndex] * distance;
+            } else {
+                loss += distance;
+            }
+        }
+        if (reachable) {
+            ranking.push_back(std::make_pair(loss, place));
+        }
+    }
+    std::sort(ranking.begin(), ranking.end());
+
+    std::vector<Selection<C> > selections(std::min((unsigned int) ranking.size(), query.k));
+    for (unsigned int selectionIndex = 0; selectionIndex < selections.size(); selectionIndex++) {
+        Selection<C> &selection = selections[selectionIndex];
+        selection.loss = ranking[selectionIndex].first;
+        selection.id = ranking[selectionIndex].second;
+        for (unsigned int branchIndex = 0; branchIndex < sources.size(); branchIndex++) {
+            selection.distances.push_back(this->distances[sources[branchIndex] * this->placesLength + selection.id]);
+        }
+    }
+    return selections;
+}
+
+template<class C>
+Oracle<C>::~Oracle() {
+}
+
+template class Oracle<Cost>;
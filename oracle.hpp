@@ -0,0 +1,34 @@
+#ifndef ORACLE_H
+#define ORACLE_H
+
+#include <vector>
+#include <iostream>
+#include "graph.hpp"
+
+/**
+ * Slow but obviously correct reference for Graph::select, meant for small graphs only.
+ * Distances between every pair of places are found with floyd-warshall, and meeting points are picked by scanning
+ * and sorting every candidate, so none of the graph's optimizations are involved.
+ */
+template<class C>
+class Oracle {
+    std::vector<unsigned int> branches;
+    unsigned int placesLength;
+    std::vector<C> distances;              // Distance from place u to place v in distances[u * placesLength + v].
+
+public:
+    Oracle();                                         // Creates an empty oracle.
+    void populate(std::istream &input);               // Populates the oracle with the same input as a graph.
+
+    /**
+     * Selects meeting points exactly like Graph::select would, for a graph populated with the same input.
+     */
+    std::vector<Selection<C> > select(const Query &query) const;
+
+    virtual ~Oracle();                                // Deconstructs an oracle.
+
+private:
+    void floydWarshall();                             // Fills distances from the edges already in it.
+};
+
+#endif //ORACLE_H
@@ -0,0 +1,53 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <ostream>
+#include "place.hpp"
+
+//
+// Payload policies, i.e. what a vertex carries besides what the algorithm needs.
+// Vertices inherit from their payload, so an empty payload takes no space at all.
+//
+
+// Carries nothing, the place id is the vertex's index in the graph.
+class NoPayload {
+public:
+    NoPayload(unsigned int id) {}
+    void setBranch() {}
+    void release() {}
+    void describe(std::ostream &output) const {}
+};
+
+// Carries the place id.
+class IdPayload {
+public:
+    unsigned int id;
+
+    IdPayload(unsigned int id) : id(id) {}
+    void setBranch() {}
+    void release() {}
+    void describe(std::ostream &output) const {
+        output << " with id " << this->id;
+    }
+};
+
+// Carries a full place, and its branch if it has one.
+class PlacePayload {
+public:
+    Place *place;
+
+    PlacePayload(unsigned int id) : place(new Place(id)) {}
+    void setBranch() {
+        if (this->place->branch == NULL) {
+            this->place->branch = new Branch();
+        }
+    }
+    void release() {
+        delete this->place;
+    }
+    void describe(std::ostream &output) const {
+        output << " has branch? " << (this->place->branch != NULL);
+    }
+};
+
+#endif //PAYLOAD_H
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "placement.hpp"
+
+#define REPORT_PAGES 0
+#define REPORT_NODES 1
+#define REPORT_PINNING 2
+
+// Kept at the start of every allocation, so that release knows how it was made.
+// PLACEMENT_HEADER bytes are reserved for it, which keeps the memory after it aligned for any type.
+struct PlacementHeader {
+    size_t length;  // Length of the mapping, or 0 if the memory came from the heap.
+};
+
+PagePolicy Placement::pages = PAGES_DEFAULT;
+NodePolicy Placement::nodes = NODES_DEFAULT;
+bool Placement::pinning = false;
+bool Placement::verbose = false;
+std::vector<int> Placement::processors;
+bool Placement::reported[3] = {false, false, false};
+
+void Placement::configure(PagePolicy pages, NodePolicy nodes, bool pinning, bool verbose) {
+    Placement::pages = pages;
+    Placement::nodes = nodes;
+    Placement::pinning = pinning;
+    Placement::verbose = verbose;
+
+    // Pin to the processors the process was given, in case it was started with taskset or in a cpuset
+    Placement::processors.clear();
+    cpu_set_t allowed;
+    if (pinning && sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int processor = 0; processor < CPU_SETSIZE; processor++) {
+            if (CPU_ISSET(processor, &allowed)) {
+                Placement::processors.push_back(processor);
+            }
+        }
+    }
+}
+
+void *Placement::allocate(size_t bytes) {
+    size_t total = bytes + PLACEMENT_HEADER;
+    char *memory = NULL;
+    size_t length = 0;
+
+    if ((Placement::pages != PAGES_DEFAULT || Placement::nodes != NODES_DEFAULT) && total >= PLACEMENT_MIN_MAPPING) {
+        // Round up to whole huge pages, so that the tail of the mapping can be backed by one too
+        length = (total + PLACEMENT_HUGE_PAGE - 1) / PLACEMENT_HUGE_PAGE * PLACEMENT_HUGE_PAGE;
+        void *mapping = MAP_FAILED;
+        if (Placement::pages == PAGES_EXPLICIT) {
+            mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mapping == MAP_FAILED) {
+                report(REPORT_PAGES, "Could not map explicit huge pages, falling back to transparent ones", errno);
+            }
+        }
+        if (mapping == MAP_FAILED) {
+            mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapping == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            if (Placement::pages != PAGES_DEFAULT && madvise(mapping, length, MADV_HUGEPAGE) != 0) {
+                report(REPORT_PAGES, "Could not ask for transparent huge pages", errno);
+            }
+        }
+
+        // Nothing has been touched yet, so every page will follow the policy.
+        // The kernel keeps only the nodes that exist and have memory out of the mask.
+        if (Placement::nodes == NODES_INTERLEAVE) {
+            unsigned long mask = ~0UL;
+            if (syscall(SYS_mbind, mapping, length, MPOL_INTERLEAVE, &mask, sizeof(mask) * 8, 0) != 0) {
+                report(REPORT_NODES, "Could not interleave the graph over the NUMA nodes", errno);
+            }
+        }
+        memory = (char *) mapping;
+    } else {
+        memory = (char *) malloc(total);
+        if (memory == NULL) {
+            throw std::bad_alloc();
+        }
+    }
+
+    ((PlacementHeader *) memory)->length = length;
+    return memory + PLACEMENT_HEADER;
+}
+
+void Placement::release(void *memory) {
+    if (memory == NULL) {
+        return;
+    }
+    char *start = (char *) memory - PLACEMENT_HEADER;
+    size_t length = ((PlacementHeader *) start)->length;
+    if (length > 0) {
+        munmap(start, length);
+    } else {
+        free(start);
+    }
+}
+
+void Placement::pin(pthread_t thread, unsigned int index) {
+    if (!Placement::pinning || Placement::processors.empty()) {
+        return;
+    }
+    cpu_set_t processor;
+    CPU_ZERO(&processor);
+    CPU_SET(Placement::processors[index % Placement::processors.size()], &processor);
+    int error = pthread_setaffinity_np(thread, sizeof(processor), &processor);
+    if (error != 0) {
+        report(REPORT_PINNING, "Could not pin a thread", error);
+    }
+}
+
+void Placement::report(unsigned int policy, const char *failure, int error) {
+    if (!Placement::verbose || Placement::reported[policy]) {
+        return;
+    }
+    Placement::reported[policy] = true;
+    std::cerr << failure << ": " << strerror(error) << std::endl;
+}
@@ -0,0 +1,115 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <pthread.h>
+
+#define PLACEMENT_HEADER 64
+#define PLACEMENT_MIN_MAPPING (1 << 20)
+#define PLACEMENT_HUGE_PAGE (2 << 20)
+
+enum PagePolicy {
+    PAGES_DEFAULT,      // Whatever the system does for the heap.
+    PAGES_TRANSPARENT,  // Regular pages, with the kernel asked to back them with transparent huge pages.
+    PAGES_EXPLICIT      // Pages from the huge page pool (vm.nr_hugepages), or transparent ones if the pool is empty.
+};
+
+enum NodePolicy {
+    NODES_DEFAULT,      // Pages go to the node of the thread that first touches them.
+    NODES_INTERLEAVE    // Pages are spread round-robin over every node, so no socket has to reach across for all of them.
+};
+
+/**
+ * Where the graph's memory and threads go, including the per-place arrays of its searches. The policies are process
+ * wide, and must be configured before the graph is populated. Allocations below PLACEMENT_MIN_MAPPING always come from the heap, big ones get their own mapping
+ * so that the policies can be applied to them.
+ */
+class Placement {
+    static PagePolicy pages;
+    static NodePolicy nodes;
+    static bool pinning;
+    static bool verbose;
+    static std::vector<int> processors;  // Processors this process may run on, in order.
+    static bool reported[3];             // Whether each policy's failure was already reported.
+
+public:
+    /**
+     * Sets the policies. When verbose, the first time the system refuses a policy it's reported on the standard error,
+     * as otherwise it would silently do nothing.
+     */
+    static void configure(PagePolicy pages, NodePolicy nodes, bool pinning, bool verbose);
+
+    static void *allocate(size_t bytes);  // Allocates memory following the policies, throws std::bad_alloc on failure.
+    static void release(void *memory);    // Releases memory given by allocate.
+
+    /**
+     * Pins a thread to the index-th processor the process may run on (wrapping around), if pinning is enabled,
+     * so that it stays close to the memory it touched first.
+     */
+    static void pin(pthread_t thread, unsigned int index);
+
+private:
+    static void report(unsigned int policy, const char *failure, int error);  // Reports a refused policy, once per policy.
+};
+
+/**
+ * Standard allocator handing out memory from Placement, for the vectors holding the vertices and the edges, and the
+ * per-place vectors of the searches.
+ */
+template<class T>
+class PlacementAllocator {
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<class U>
+    struct rebind {
+        typedef PlacementAllocator<U> other;
+    };
+
+    PlacementAllocator() {}
+    PlacementAllocator(const PlacementAllocator &other) {}
+    template<class U>
+    PlacementAllocator(const PlacementAllocator<U> &other) {}
+
+    pointer address(reference value) const {
+        return &value;
+    }
+    const_pointer address(const_reference value) const {
+        return &value;
+    }
+    pointer allocate(size_type length, const void *hint = 0) {
+        return (pointer) Placement::allocate(length * sizeof(T));
+    }
+    void deallocate(pointer memory, size_type length) {
+        Placement::release(memory);
+    }
+    size_type max_size() const {
+        return ((size_type) -1 - PLACEMENT_HEADER) / sizeof(T);
+    }
+    void construct(pointer memory, const T &value) {
+        new((void *) memory) T(value);
+    }
+    void destroy(pointer memory) {
+        memory->~T();
+    }
+};
+
+template<class T, class U>
+bool operator==(const PlacementAllocator<T> &left, const PlacementAllocator<U> &right) {
+    return true;
+}
+
+template<class T, class U>
+bool operator!=(const PlacementAllocator<T> &left, const PlacementAllocator<U> &right) {
+    return false;
+}
+
+#endif //PLACEMENT_H
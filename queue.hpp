@@ -0,0 +1,98 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+//
+// Queue policies for the dijkstra searches. Both are min-heaps: the smallest element is on top.
+//
+
+template<class T>
+class BinaryHeap {
+    std::vector<T> heap;
+
+public:
+    bool empty() const {
+        return this->heap.empty();
+    }
+
+    const T &top() const {
+        return this->heap.front();
+    }
+
+    void push(const T &element) {
+        this->heap.push_back(element);
+        std::push_heap(this->heap.begin(), this->heap.end(), std::greater<T>());
+    }
+
+    void pop() {
+        std::pop_heap(this->heap.begin(), this->heap.end(), std::greater<T>());
+        this->heap.pop_back();
+    }
+};
+
+/**
+ * Heap where every node has 4 children. It's half as deep as a binary heap and a node's children share a cache line,
+ * which makes pushes cheaper at the cost of a few more comparisons per pop.
+ */
+template<class T>
+class QuaternaryHeap {
+    std::vector<T> heap;
+
+public:
+    bool empty() const {
+        return this->heap.empty();
+    }
+
+    const T &top() const {
+        return this->heap.front();
+    }
+
+    void push(const T &element) {
+        // Move the element up while it's smaller than its parent
+        unsigned int index = this->heap.size();
+        this->heap.push_back(element);
+        while (index > 0) {
+            unsigned int parent = (index - 1) / 4;
+            if (!(element < this->heap[parent])) {
+                break;
+            }
+            this->heap[index] = this->heap[parent];
+            index = parent;
+        }
+        this->heap[index] = element;
+    }
+
+    void pop() {
+        // Move the last element down from the top while one of its children is smaller
+        T element = this->heap.back();
+        this->heap.pop_back();
+        unsigned int length = this->heap.size();
+        if (length == 0) {
+            return;
+        }
+        unsigned int index = 0;
+        while (true) {
+            unsigned int first = index * 4 + 1;
+            if (first >= length) {
+                break;
+            }
+            unsigned int smallest = first;
+            for (unsigned int child = first + 1; child < first + 4 && child < length; child++) {
+                if (this->heap[child] < this->heap[smallest]) {
+                    smallest = child;
+                }
+            }
+            if (!(this->heap[smallest] < element)) {
+                break;
+            }
+            this->heap[index] = this->heap[smallest];
+            index = smallest;
+        }
+        this->heap[index] = element;
+    }
+};
+
+#endif //QUEUE_H
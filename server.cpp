@@ -0,0 +1,198 @@
+#include <iostream>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.hpp"
+
+Server::Server(BotnetGraph *graph, const Query &defaults, const std::string &path, unsigned int workersLength) {
+    this->graph = graph;
+    this->defaults = defaults;
+    this->path = path;
+    this->listener = -1;
+    this->workersLength = workersLength > 0 ? workersLength : 1;
+    this->threadsLength = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN) / (long) this->workersLength);
+}
+
+bool Server::serve() {
+    // Do the expensive part once, queries only read the graph from here on
+    this->graph->prepare();
+
+    // Answers are written straight to the connections, so a client leaving early must not take the whole server down
+    signal(SIGPIPE, SIG_IGN);
+
+    // Bind the socket, replacing whatever was left behind by a previous server
+    struct sockaddr_un address;
+    if (this->path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << this->path << std::endl;
+        return false;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, this->path.c_str());
+    unlink(this->path.c_str());
+
+    this->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (this->listener == -1 || bind(this->listener, (struct sockaddr *) &address, sizeof(address)) == -1 || listen(this->listener, SOMAXCONN) == -1) {
+        std::cerr << "Could not listen on " << this->path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Every worker accepts connections on its own, the kernel hands each connection to a single one of them.
+    // Only the workers that could be started are kept, the server runs with fewer if the system refuses some.
+    std::vector<pthread_t> workers;
+    for (unsigned int workerIndex = 0; workerIndex < this->workersLength; workerIndex++) {
+        pthread_t worker;
+        int error = pthread_create(&worker, NULL, Server::worker, this);
+        if (error != 0) {
+            std::cerr << "Could not start worker " << workerIndex << ": " << strerror(error) << std::endl;
+            break;
+        }
+        Placement::pin(worker, workerIndex);
+        workers.push_back(worker);
+    }
+    if (workers.empty()) {
+        return false;
+    }
+    // Workers only stop once the listener is unusable, so the server has failed if they all did
+    for (unsigned int workerIndex = 0; workerIndex < workers.size(); workerIndex++) {
+        pthread_join(workers[workerIndex], NULL);
+    }
+    return false;
+}
+
+void *Server::worker(void *argument) {
+    ((Server *) argument)->work();
+    return NULL;
+}
+
+void Server::work() {
+    while (true) {
+        int connection = accept(this->listener, NULL, NULL);
+        if (connection == -1) {
+            // Only a listener that was closed or isn't one stops the worker, the rest (out of descriptors or memory,
+            // a client that left) go away on their own, so wait a bit and try again
+            if (errno == EBADF || errno == EINVAL || errno == ENOTSOCK || errno == EOPNOTSUPP) {
+                std::cerr << "Stopped accepting connections: " << strerror(errno) << std::endl;
+                return;
+            }
+            if (errno != EINTR && errno != ECONNABORTED) {
+                usleep(SERVER_RETRY_DELAY);
+            }
+            continue;
+        }
+        answer(connection);
+        close(connection);
+    }
+}
+
+void Server::answer(int connection) {
+    std::string buffer;
+    std::string line;
+    while (readLine(connection, buffer, line, SERVER_MAX_LINE)) {
+        Query query = this->defaults;
+        Writer writer(connection);
+        if (parse(line, query)) {
+            this->graph->printSelections(writer, this->graph->select(query, this->threadsLength), FORMAT_TEXT);
+        } else {
+            writer.write("E\n", 2);
+        }
+        writer.write(SERVER_END_OF_ANSWER "\n", sizeof(SERVER_END_OF_ANSWER));
+
+        if (!writer.flush()) {
+            return;
+        }
+    }
+
+    // A line too long to be a query is answered as invalid and the connection dropped, rather than kept in memory
+    if (buffer.size() > SERVER_MAX_LINE) {
+        writeAll(connection, "E\n" SERVER_END_OF_ANSWER "\n");
+    }
+}
+
+bool Server::parse(const std::string &line, Query &query) const {
+    std::istringstream input(line);
+    std::string word;
+    query.branches.clear();
+    for (bool first = true; input >> word; first = false) {
+        // The first word can pick the engine for this query only
+        if (first && word == "dijkstra") {
+            query.engine = ENGINE_DIJKSTRA;
+            continue;
+        } else if (first && word == "delta") {
+            query.engine = ENGINE_DELTA_STEPPING;
+            continue;
+        } else if (first && word == "auto") {
+            query.engine = ENGINE_AUTO;
+            continue;
+        }
+
+        // Anything else that isn't a place id makes the query invalid
+        if (word.find_first_not_of("0123456789") != std::string::npos || word.size() > 9) {
+            return false;
+        }
+        unsigned int id = atoi(word.c_str());
+        if (id < PLACES_START_INDEX || id > this->graph->getPlacesLength()) {
+            return false;
+        }
+        query.branches.push_back(id);
+    }
+    // Weights given to the server belong to the graph's branches, the query's own branches all weigh 1
+    if (!query.branches.empty()) {
+        query.weights.clear();
+    }
+    return true;
+}
+
+bool Server::readLine(int socket, std::string &buffer, std::string &line, std::string::size_type maximumLength) {
+    std::string::size_type end;
+    while ((end = buffer.find('\n')) == std::string::npos) {
+        if (buffer.size() > maximumLength) {
+            return false;
+        }
+        char chunk[4096];
+        ssize_t length = read(socket, chunk, sizeof(chunk));
+        if (length == -1 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            return false;
+        }
+        buffer.append(chunk, length);
+    }
+    if (end > maximumLength) {
+        return false;
+    }
+    line = buffer.substr(0, end);
+    buffer.erase(0, end + 1);
+    return true;
+}
+
+bool Server::writeAll(int socket, const std::string &text) {
+    std::string::size_type written = 0;
+    while (written < text.size()) {
+        // MSG_NOSIGNAL so that a client leaving early doesn't take the whole server down with SIGPIPE
+        ssize_t length = send(socket, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+        if (length == -1 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            return false;
+        }
+        written += length;
+    }
+    return true;
+}
+
+Server::~Server() {
+    if (this->listener != -1) {
+        close(this->listener);
+        unlink(this->path.c_str());
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <pthread.h>
+#include "graph.hpp"
+
+#define SERVER_END_OF_ANSWER "."
+#define SERVER_MAX_LINE (1 << 20)  // Longest query line, in bytes.
+#define SERVER_RETRY_DELAY 100000  // Microseconds to wait before accepting again after a temporary failure.
+
+/**
+ * Answers meeting point queries over a unix domain socket, one line per query.
+ * A query is the list of place ids of the branches meeting, separated by spaces (an empty line meaning the graph's
+ * own branches), optionally preceded by the engine for that query only (dijkstra, delta or auto). The answer is what
+ * botnet would print for those branches, or "E" if the query is invalid, followed by a line with just
+ * SERVER_END_OF_ANSWER. Answers can have empty lines (e.g. with no branches), so an empty line can't end them.
+ * Connections can send as many queries as they want. A line longer than SERVER_MAX_LINE is answered with "E" and its
+ * connection closed.
+ */
+class Server {
+    BotnetGraph *graph;
+    Query defaults;
+    std::string path;
+    int listener;
+    unsigned int workersLength;
+    unsigned int threadsLength;  // Threads each query may use, so that busy workers don't run more threads than there are cores.
+
+public:
+    /**
+     * Creates a server for an already populated graph. Queries get the options (k, objective, candidates) of
+     * defaults, with their own branches. Weights only apply to queries for the graph's own branches.
+     * The cores are split evenly between the workers, for the queries they run.
+     */
+    Server(BotnetGraph *graph, const Query &defaults, const std::string &path, unsigned int workersLength);
+
+    /**
+     * Prepares the graph, then binds the socket and answers queries with workersLength threads, until killed.
+     * Returns false if the socket couldn't be set up, not even one worker could be started, or the listener stopped
+     * working.
+     */
+    bool serve();
+
+    virtual ~Server();
+
+    /**
+     * Reads a line from a socket, without its newline, keeping whatever came after it in buffer.
+     * Returns false once the socket is closed and no complete line is left, or if the line is longer than maximumLength,
+     * in which case buffer is left holding more than maximumLength bytes.
+     */
+    static bool readLine(int socket, std::string &buffer, std::string &line, std::string::size_type maximumLength = std::string::npos);
+
+    /**
+     * Writes the whole text to a socket. Returns false if the other side went away.
+     */
+    static bool writeAll(int socket, const std::string &text);
+
+private:
+    static void *worker(void *argument);  // Entry point of the worker threads.
+    void work();                          // Accepts connections and answers them until the listener is unusable.
+    void answer(int connection);          // Answers every query of a connection.
+    bool parse(const std::string &line, Query &query) const;  // Fills the query's branches from a query line.
+};
+
+#endif //SERVER_H
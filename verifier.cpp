@@ -0,0 +1,180 @@
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <cstdlib>
+#include <unistd.h>
+#include "verifier.hpp"
+#include "oracle.hpp"
+
+#define VERIFIER_MAX_PLACES 30
+#define VERIFIER_MAX_COST 20
+#define VERIFIER_MAX_POTENTIAL 10
+#define VERIFIER_MAX_WEIGHT 5
+#define VERIFIER_LARGE_EVERY 10
+#define VERIFIER_MIN_LARGE_PLACES 130
+#define VERIFIER_MAX_LARGE_PLACES 200
+#define VERIFIER_MIN_LARGE_BRANCHES 64
+
+Verifier::Verifier(unsigned int rounds) {
+    this->rounds = rounds;
+}
+
+bool Verifier::run() {
+    const Engine engines[] = {ENGINE_DIJKSTRA, ENGINE_DELTA_STEPPING};
+    for (unsigned int round = 1; round <= this->rounds; round++) {
+        Query query;
+        std::string input = generate(round, query);
+
+        std::istringstream oracleInput(input);
+        Oracle<Cost> oracle;
+        oracle.populate(oracleInput);
+        std::vector<Selection<Cost> > expected = oracle.select(query);
+
+        std::istringstream graphInput(input);
+        BotnetGraph graph;
+        graph.populate(graphInput);
+        graph.prepare();
+        for (unsigned int engineIndex = 0; engineIndex < sizeof(engines) / sizeof(engines[0]); engineIndex++) {
+            query.engine = engines[engineIndex];
+            std::vector<Selection<Cost> > actual = graph.select(query);
+            if (!same(expected, actual)) {
+                std::cerr << "Mismatch on round " << round << " with engine " << engines[engineIndex] << std::endl;
+                report(graph, input, query, expected, actual);
+                return false;
+            }
+        }
+    }
+    std::cerr << "Verified " << this->rounds << " rounds" << std::endl;
+    return true;
+}
+
+std::string Verifier::generate(unsigned int seed, Query &query) {
+    srand(seed);
+
+    // Some rounds are larger, with at least 64 branches in components of their own, so that prune has to split them
+    // into one or more full groups of 64
+    bool large = seed % VERIFIER_LARGE_EVERY == 0;
+    unsigned int placesLength = large ? random(VERIFIER_MIN_LARGE_PLACES, VERIFIER_MAX_LARGE_PLACES) : random(1, VERIFIER_MAX_PLACES);
+    unsigned int branchesLength = large ? random(VERIFIER_MIN_LARGE_BRANCHES, placesLength) : random(1, placesLength);
+
+    // Costs are a non-negative part plus the difference of the potentials of their ends, so every cycle is non-negative
+    std::vector<int> potentials(placesLength + 1);
+    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex <= placesLength; placeIndex++) {
+        potentials[placeIndex] = (int) random(0, 2 * VERIFIER_MAX_POTENTIAL) - VERIFIER_MAX_POTENTIAL;
+    }
+
+    // Branches are distinct places, like in the project's inputs
+    std::vector<unsigned int> places;
+    for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex <= placesLength; placeIndex++) {
+        places.push_back(placeIndex);
+    }
+    std::vector<unsigned int> branches;
+    for (unsigned int branchIndex = 0; branchIndex < branchesLength; branchIndex++) {
+        std::swap(places[branchIndex], places[random(branchIndex, placesLength - 1)]);
+        branches.push_back(places[branchIndex]);
+    }
+
+    std::vector<std::pair<unsigned int, unsigned int> > links;
+    if (large) {
+        // Every place links to some later one, so the last place is reachable from every branch while the places
+        // before it are reachable from different sets of them, and the other links only go back a couple of places,
+        // so most components stay small
+        for (unsigned int placeIndex = PLACES_START_INDEX; placeIndex < placesLength; placeIndex++) {
+            links.push_back(std::make_pair(placeIndex, random(placeIndex + 1, placesLength)));
+        }
+        unsigned int extraLength = random(0, placesLength);
+        for (unsigned int connection = 0; connection < extraLength; connection++) {
+            unsigned int from = random(1, placesLength);
+            links.push_back(std::make_pair(from, random(from > 2 ? from - 2 : 1, placesLength)));
+        }
+    } else {
+        unsigned int linksLength = random(0, placesLength * 4);
+        for (unsigned int connection = 0; connection < linksLength; connection++) {
+            unsigned int from = random(1, placesLength);
+            links.push_back(std::make_pair(from, random(1, placesLength)));
+        }
+    }
+
+    std::ostringstream output;
+    output << placesLength << " " << branchesLength << " " << links.size() << std::endl;
+    for (unsigned int branchIndex = 0; branchIndex < branchesLength; branchIndex++) {
+        output << branches[branchIndex] << (branchIndex + 1 < branchesLength ? " " : "");
+    }
+    output << std::endl;
+    for (unsigned int connection = 0; connection < links.size(); connection++) {
+        unsigned int from = links[connection].first;
+        unsigned int to = links[connection].second;
+        output << from << " " << to << " " << (int) random(0, VERIFIER_MAX_COST) + potentials[from] - potentials[to] << std::endl;
+    }
+
+    // Every option of a query, each with some chance of being used
+    query.k = random(1, 4);
+    query.objective = (Objective) random(OBJECTIVE_SUM, OBJECTIVE_WEIGHTED_SUM);
+    query.branchesOnly = random(0, 3) == 0;
+    if (random(0, 3) == 0) {
+        // Queries coming from the server can repeat branches
+        unsigned int queryBranchesLength = random(1, placesLength);
+        for (unsigned int branchIndex = 0; branchIndex < queryBranchesLength; branchIndex++) {
+            query.branches.push_back(random(1, placesLength));
+        }
+    }
+    if (random(0, 3) == 0) {
+        unsigned int candidatesLength = random(1, placesLength);
+        for (unsigned int candidateIndex = 0; candidateIndex < candidatesLength; candidateIndex++) {
+            query.candidates.push_back(random(1, placesLength));
+        }
+    }
+    if (query.objective == OBJECTIVE_WEIGHTED_SUM) {
+        // Fewer weights than branches is allowed, the rest weigh 1
+        unsigned int weightsLength = random(0, branchesLength);
+        for (unsigned int weightIndex = 0; weightIndex < weightsLength; weightIndex++) {
+            query.weights.push_back(random(0, VERIFIER_MAX_WEIGHT));
+        }
+    }
+    return output.str();
+}
+
+unsigned int Verifier::random(unsigned int low, unsigned int high) {
+    return low + rand() % (high - low + 1);
+}
+
+bool Verifier::same(const std::vector<Selection<Cost> > &expected, const std::vector<Selection<Cost> > &actual) {
+    if (expected.size() != actual.size()) {
+        return false;
+    }
+    for (unsigned int selectionIndex = 0; selectionIndex < expected.size(); selectionIndex++) {
+        if (expected[selectionIndex].id != actual[selectionIndex].id || expected[selectionIndex].loss != actual[selectionIndex].loss ||
+            expected[selectionIndex].distances != actual[selectionIndex].distances) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Verifier::report(const BotnetGraph &graph, const std::string &input, const Query &query,
+                      const std::vector<Selection<Cost> > &expected, const std::vector<Selection<Cost> > &actual) {
+    std::cerr << input;
+    std::cerr << "k " << query.k << ", objective " << query.objective << ", branches only " << query.branchesOnly << std::endl;
+    std::cerr << "branches:";
+    for (unsigned int branchIndex = 0; branchIndex < query.branches.size(); branchIndex++) {
+        std::cerr << " " << query.branches[branchIndex];
+    }
+    std::cerr << std::endl << "candidates:";
+    for (unsigned int candidateIndex = 0; candidateIndex < query.candidates.size(); candidateIndex++) {
+        std::cerr << " " << query.candidates[candidateIndex];
+    }
+    std::cerr << std::endl << "weights:";
+    for (unsigned int weightIndex = 0; weightIndex < query.weights.size(); weightIndex++) {
+        std::cerr << " " << query.weights[weightIndex];
+    }
+    std::cerr << std::endl;
+
+    Writer writer(STDERR_FILENO);
+    writer.write("expected:\n", 10);
+    graph.printSelections(writer, expected, FORMAT_TEXT);
+    writer.write("actual:\n", 8);
+    graph.printSelections(writer, actual, FORMAT_TEXT);
+}
+
+Verifier::~Verifier() {
+}
@@ -0,0 +1,36 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <string>
+#include <vector>
+#include "graph.hpp"
+
+/**
+ * Differential tester: generates random small graphs and queries, and checks that every engine of the graph selects
+ * exactly what the floyd-warshall oracle does. Graphs are generated from random potentials, so they can have negative
+ * edges but never negative cycles. Every VERIFIER_LARGE_EVERY-th graph is larger, with 64 branches or more, to cover
+ * the grouping of the branches when pruning. Round r always uses seed r, so failures can be reproduced.
+ */
+class Verifier {
+    unsigned int rounds;
+
+public:
+    Verifier(unsigned int rounds);  // Creates a verifier for the given number of rounds.
+
+    /**
+     * Runs every round, stopping at the first mismatch, which is printed to the standard error along with its input.
+     * Returns false if there was a mismatch.
+     */
+    bool run();
+
+    virtual ~Verifier();
+
+private:
+    static std::string generate(unsigned int seed, Query &query);  // Returns a random input, and fills a random query for it.
+    static unsigned int random(unsigned int low, unsigned int high);  // Returns a random number from low up to high.
+    static bool same(const std::vector<Selection<Cost> > &expected, const std::vector<Selection<Cost> > &actual);
+    static void report(const BotnetGraph &graph, const std::string &input, const Query &query,
+                       const std::vector<Selection<Cost> > &expected, const std::vector<Selection<Cost> > &actual);
+};
+
+#endif //VERIFIER_H
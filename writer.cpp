@@ -0,0 +1,98 @@
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include "writer.hpp"
+
+// Every number from 00 to 99, so that integers can be converted two digits at a time
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+Writer::Writer(int descriptor, unsigned int capacity) {
+    this->descriptor = descriptor;
+    this->capacity = capacity;
+    this->buffer = new char[capacity];
+    this->length = 0;
+    this->failed = false;
+}
+
+void Writer::write(const char *data, unsigned int length) {
+    if (this->length + length > this->capacity) {
+        flush();
+        // Too big to be buffered at all, so skip the copy
+        if (length > this->capacity) {
+            unsigned int written = 0;
+            while (!this->failed && written < length) {
+                ssize_t chunk = ::write(this->descriptor, data + written, length - written);
+                if (chunk == -1 && errno == EINTR) {
+                    continue;
+                }
+                this->failed = chunk <= 0;
+                written += chunk > 0 ? chunk : 0;
+            }
+            return;
+        }
+    }
+    memcpy(this->buffer + this->length, data, length);
+    this->length += length;
+}
+
+void Writer::write(char character) {
+    if (this->length == this->capacity) {
+        flush();
+    }
+    this->buffer[this->length++] = character;
+}
+
+void Writer::writeInteger(int64_t value) {
+    // Fill the digits from the end, working on the magnitude as unsigned so that the minimum value doesn't overflow
+    char digits[20];
+    unsigned int start = sizeof(digits);
+    uint64_t magnitude = value < 0 ? -(uint64_t) value : (uint64_t) value;
+    while (magnitude >= 100) {
+        unsigned int pair = (magnitude % 100) * 2;
+        magnitude /= 100;
+        digits[--start] = DIGIT_PAIRS[pair + 1];
+        digits[--start] = DIGIT_PAIRS[pair];
+    }
+    if (magnitude >= 10) {
+        unsigned int pair = magnitude * 2;
+        digits[--start] = DIGIT_PAIRS[pair + 1];
+        digits[--start] = DIGIT_PAIRS[pair];
+    } else {
+        digits[--start] = '0' + magnitude;
+    }
+
+    if (value < 0) {
+        write('-');
+    }
+    write(digits + start, sizeof(digits) - start);
+}
+
+void Writer::writeBinary(uint32_t value) {
+    write((const char *) &value, sizeof(value));
+}
+
+void Writer::writeBinary(int64_t value) {
+    write((const char *) &value, sizeof(value));
+}
+
+bool Writer::flush() {
+    unsigned int written = 0;
+    while (!this->failed && written < this->length) {
+        ssize_t chunk = ::write(this->descriptor, this->buffer + written, this->length - written);
+        if (chunk == -1 && errno == EINTR) {
+            continue;
+        }
+        this->failed = chunk <= 0;
+        written += chunk > 0 ? chunk : 0;
+    }
+    this->length = 0;
+    return !this->failed;
+}
+
+Writer::~Writer() {
+    flush();
+    delete[] this->buffer;
+}
@@ -0,0 +1,35 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdint.h>
+
+#define WRITER_CAPACITY 65536
+
+enum Format {
+    FORMAT_TEXT,    // The project's output format.
+    FORMAT_BINARY   // Fixed size fields in the machine's byte order, for tools that read the results back.
+};
+
+/**
+ * Buffers output for a file descriptor, and hands it to the kernel with a single write() whenever the buffer fills up
+ * or is flushed. Integers are converted to text by hand, two digits at a time.
+ */
+class Writer {
+    int descriptor;
+    char *buffer;
+    unsigned int length;
+    unsigned int capacity;
+    bool failed;
+
+public:
+    Writer(int descriptor, unsigned int capacity = WRITER_CAPACITY);  // Creates a writer for an open file descriptor.
+    void write(const char *data, unsigned int length);                 // Writes raw bytes.
+    void write(char character);                                        // Writes a single character.
+    void writeInteger(int64_t value);                                  // Writes an integer as text.
+    void writeBinary(uint32_t value);                                  // Writes an integer as 4 raw bytes.
+    void writeBinary(int64_t value);                                   // Writes an integer as 8 raw bytes.
+    bool flush();                                                      // Writes out the buffer, returns false on errors.
+    virtual ~Writer();                                                 // Flushes and deconstructs a writer.
+};
+
+#endif //WRITER_H